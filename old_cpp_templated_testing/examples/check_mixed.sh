@@ -0,0 +1,58 @@
+#!/bin/sh
+# check --mixed against double precision on sierpinski_zoom.json
+# renders the flame twice in double and once with --mixed, the normalized L1
+# difference (sum of |a/sum(a)-b/sum(b)| over the histogram) of mixed from
+# double must be at most max_ratio times the difference of the two double
+# renders (the sampling noise), exits 1 if it is not
+# usage: check_mixed.sh ffgray [samples] [mixed iterations] [max_ratio]
+set -e
+if [ $# -lt 1 ]; then
+    echo "usage: $0 ffgray [samples] [mixed iterations] [max_ratio]" >&2
+    exit 2
+fi
+FFGRAY=$1
+SAMPLES=${2:-20000000}
+MIXED=${3:-16}
+MAX_RATIO=${4:-1.25}
+FLAME=$(dirname "$0")/sierpinski_zoom.json
+DIR=$(mktemp -d)
+trap 'rm -r "$DIR"' EXIT
+render()
+{
+    NAME=$1
+    shift
+    "$FFGRAY" -f "$FLAME" -o "$DIR/$NAME.buf" -t buf -s "$SAMPLES" "$@" \
+        > /dev/null 2>&1 || { echo "error: render failed: $*" >&2; exit 2; }
+}
+# normalized L1 difference of two 32 bit histograms
+l1()
+{
+    od -An -v -tu4 -w4 "$DIR/$1.buf" > "$DIR/$1.txt"
+    od -An -v -tu4 -w4 "$DIR/$2.buf" > "$DIR/$2.txt"
+    paste "$DIR/$1.txt" "$DIR/$2.txt" | awk '
+        { a[NR] = $1; b[NR] = $2; sa += $1; sb += $2 }
+        END {
+            if (sa == 0 || sb == 0) { print 2; exit }
+            for (i = 1; i <= NR; ++i)
+            {
+                d = a[i]/sa - b[i]/sb
+                s += d < 0 ? -d : d
+            }
+            printf "%.6f\n", s
+        }'
+}
+render double1 -p double
+render double2 -p double
+render mixed --mixed "$MIXED"
+NOISE=$(l1 double1 double2)
+DIFF=$(l1 double1 mixed)
+echo "double/double L1: $NOISE"
+echo "double/mixed L1: $DIFF"
+if awk -v d="$DIFF" -v n="$NOISE" -v r="$MAX_RATIO" \
+        'BEGIN { exit !(d <= r*n) }'; then
+    echo "ok"
+else
+    echo "fail: mixed differs from double by more than $MAX_RATIO times" \
+        "the sampling noise"
+    exit 1
+fi
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "json_small.hpp"
+#include "renderer.hpp"
+#include "thread_pool.hpp"
+#include "types.hpp"
+
+namespace tkoz
+{
+namespace flame
+{
+
+/*
+keyframed flame animation, the JSON is a list of flames (keyframes) with an
+optional "time" (default is the keyframe index) that must be increasing
+all numbers (affines, weights, variation parameters, bounds, colors) are
+interpolated linearly between neighboring keyframes, so neighboring keyframes
+must have the same structure (xform count, palette length), except that a
+variation in only one of them fades in or out (weight from/to 0), xforms
+with weight 0 are kept with a tiny weight so every time has the same xforms
+*/
+template <typename num_t, typename rand_t>
+class Animation
+{
+private:
+    std::vector<Json> keyframes;
+    std::vector<double> times;
+    // keyframe pairs (i-1,i) with their variations lists made to match
+    std::vector<std::pair<Json,Json>> segments;
+    Animation(){}
+    // match variation lists of two xforms by name, variations missing from
+    // one of them are added there with weight 0
+    static void alignVariations(Json& a, Json& b)
+    {
+        JsonArray va = a["variations"].arrayValue();
+        JsonArray vb = b["variations"].arrayValue();
+        Json ra(nlohmann::json::array()), rb(nlohmann::json::array());
+        std::vector<bool> used(vb.size());
+        Json zero(nlohmann::json(0.0));
+        for (Json var : va)
+        {
+            size_t j = 0;
+            while (j < vb.size() && (used[j] || vb[j]["name"].stringValue()
+                    != var["name"].stringValue()))
+                ++j;
+            ra.append(var);
+            if (j < vb.size())
+            {
+                used[j] = true;
+                rb.append(vb[j]);
+            }
+            else
+            {
+                var.setValue("weight",zero);
+                rb.append(var);
+            }
+        }
+        for (size_t j = 0; j < vb.size(); ++j)
+            if (!used[j])
+            {
+                Json var = vb[j];
+                rb.append(var);
+                var.setValue("weight",zero);
+                ra.append(var);
+            }
+        a.setValue("variations",ra);
+        b.setValue("variations",rb);
+    }
+    // give xforms with weight 0 a tiny weight instead (Flame drops them, so
+    // flames at different times would have different xforms, which motion
+    // blur requires to match)
+    static void keepZeroWeightXForms(Json& keyframe)
+    {
+        JsonArray xforms = keyframe["xforms"].arrayValue();
+        Json ret(nlohmann::json::array());
+        Json tiny(nlohmann::json(1e-9));
+        for (Json xf : xforms)
+        {
+            Json weight;
+            if (xf.valueAt("weight",weight) && weight.floatValue() == 0.0)
+                xf.setValue("weight",tiny);
+            ret.append(xf);
+        }
+        keyframe.setValue("xforms",ret);
+    }
+    static void alignFlames(Json& a, Json& b)
+    {
+        JsonArray xa = a["xforms"].arrayValue();
+        JsonArray xb = b["xforms"].arrayValue();
+        if (xa.size() != xb.size())
+            throw std::runtime_error("keyframe xform counts differ");
+        Json ra(nlohmann::json::array()), rb(nlohmann::json::array());
+        for (size_t i = 0; i < xa.size(); ++i)
+        {
+            alignVariations(xa[i],xb[i]);
+            ra.append(xa[i]);
+            rb.append(xb[i]);
+        }
+        a.setValue("xforms",ra);
+        b.setValue("xforms",rb);
+        Json fa,fb;
+        if (a.valueAt("final_xform",fa) && b.valueAt("final_xform",fb))
+        {
+            alignVariations(fa,fb);
+            a.setValue("final_xform",fa);
+            b.setValue("final_xform",fb);
+        }
+    }
+public:
+    // construct from JSON data
+    // throws error if something goes wrong
+    Animation(const Json& input)
+    {
+        for (Json keyframe : input.arrayValue())
+        {
+            Json time;
+            double t = keyframe.valueAt("time",time)
+                ? time.floatValue() : (double)keyframes.size();
+            if (!times.empty() && t <= times.back())
+                throw std::runtime_error("keyframe times must be increasing");
+            keepZeroWeightXForms(keyframe);
+            keyframes.push_back(keyframe);
+            times.push_back(t);
+        }
+        if (keyframes.empty())
+            throw std::runtime_error("animation has no keyframes");
+        Flame<num_t,rand_t> first(keyframes[0]);
+        for (size_t i = 1; i < keyframes.size(); ++i)
+        {
+            Json a = keyframes[i-1], b = keyframes[i];
+            alignFlames(a,b);
+            // checks that the structures can be interpolated
+            Flame<num_t,rand_t> flame(a.interpolate(b,0.5));
+            Flame<num_t,rand_t> next(b);
+            if (next.getSizeX() != first.getSizeX()
+                    || next.getSizeY() != first.getSizeY())
+                throw std::runtime_error("keyframe sizes differ");
+            segments.push_back(std::make_pair(a,b));
+        }
+    }
+    inline size_t getKeyframeCount() const { return keyframes.size(); }
+    inline double getStartTime() const { return times.front(); }
+    inline double getEndTime() const { return times.back(); }
+    // time of frame i when frames are spaced evenly from start to end time
+    double frameTime(size_t i, size_t frames) const
+    {
+        if (frames < 2)
+            return getStartTime();
+        return getStartTime() + (getEndTime()-getStartTime())*i/(frames-1);
+    }
+    // flame JSON at time t (clamped to the keyframe time range)
+    Json flameJsonAt(double t) const
+    {
+        if (t <= times.front())
+            return keyframes.front();
+        if (t >= times.back())
+            return keyframes.back();
+        size_t i = std::upper_bound(times.begin(),times.end(),t)
+            - times.begin();
+        double s = (t-times[i-1])/(times[i]-times[i-1]);
+        return segments[i-1].first.interpolate(segments[i-1].second,s);
+    }
+    inline Flame<num_t,rand_t> flameAt(double t) const
+    { return Flame<num_t,rand_t>(flameJsonAt(t)); }
+};
+
+/*
+renders animation frames reusing the histograms, thread pool and rngs
+two renderers alternate so the output (tone mapping, encoding) of a frame
+runs on its own thread while the next frame is iterated
+*/
+template <typename num_t, typename hist_t, typename rand_t>
+class AnimationRenderer
+{
+private:
+    typedef RendererBasic<num_t,hist_t,rand_t> renderer_t;
+    Animation<num_t,rand_t> animation;
+    std::shared_ptr<ThreadPool> pool;
+    std::unique_ptr<renderer_t> renderers[2];
+    double shutter; // fraction of the time between frames, 0 for no blur
+    size_t blur_buckets; // times in the shutter interval
+    AnimationRenderer(const AnimationRenderer&) = delete;
+    AnimationRenderer& operator=(const AnimationRenderer&) = delete;
+public:
+    // renderer options are the same as for RendererBasic
+    AnimationRenderer(const Animation<num_t,rand_t>& animation,
+            size_t threads = 1, size_t oversample = 1,
+            color_mode_t color_mode = COLOR_NONE,
+            std::function<void(std::thread&,size_t)> thread_callback = nullptr):
+        animation(animation),
+        pool(std::make_shared<ThreadPool>(threads,thread_callback)),
+        shutter(0.0),blur_buckets(1)
+    {
+        Flame<num_t,rand_t> flame = animation.flameAt(
+            animation.getStartTime());
+        for (size_t i = 0; i < 2; ++i)
+        {
+            renderers[i].reset(new renderer_t(flame,nullptr,oversample,
+                color_mode));
+            renderers[i]->setThreadPool(pool);
+        }
+    }
+    inline const Animation<num_t,rand_t>& getAnimation() const
+    { return animation; }
+    void setFilter(filter_t filter)
+    {
+        for (size_t i = 0; i < 2; ++i)
+            renderers[i]->setFilter(filter);
+    }
+    void setDensityEstimation(num_t max_radius, num_t min_radius = 0.0,
+        num_t curve = 0.4)
+    {
+        for (size_t i = 0; i < 2; ++i)
+            renderers[i]->setDensityEstimation(max_radius,min_radius,curve);
+    }
+    void setChains(size_t chains)
+    {
+        for (size_t i = 0; i < 2; ++i)
+            renderers[i]->setChains(chains);
+    }
+    // motion blur over shutter (fraction of the time between frames)
+    // centered on each frame time, sample times are one of buckets evenly
+    // spaced times whose flames are made once per frame
+    void setMotionBlur(double shutter, size_t buckets)
+    {
+        if (shutter < 0.0)
+            throw std::runtime_error("shutter must be nonnegative");
+        if (buckets < 1 || buckets > max_blur_buckets)
+            throw std::runtime_error("motion blur buckets out of bounds");
+        this->shutter = shutter;
+        blur_buckets = buckets;
+    }
+    // render frames evenly spaced over the animation with samples each
+    // frame_done(k,renderer) is called after frame k is iterated and
+    // output(k,renderer) makes its image on a separate thread (overlapping
+    // iteration of frame k+1), stops if output returns false
+    // returns true if every frame was rendered and output
+    bool render(size_t frames, size_t samples, size_t batch_size = 1 << 16,
+        size_t bad_value_limit = 10,
+        std::function<bool(size_t,renderer_t&)> output = nullptr,
+        std::function<void(size_t,const renderer_t&,render_status_t)>
+            frame_done = nullptr)
+    {
+        bool output_ok = true;
+        std::thread output_thread;
+        for (size_t k = 0; k < frames; ++k)
+        {
+            // the output thread for frame k-2 already finished with this one
+            renderer_t& renderer = *renderers[k%2];
+            try
+            {
+                double t = animation.frameTime(k,frames);
+                renderer.setFlame(animation.flameAt(t));
+                if (shutter > 0.0 && blur_buckets > 1 && frames > 1)
+                {
+                    double dt = shutter*(animation.getEndTime()
+                        -animation.getStartTime())/(frames-1);
+                    std::vector<Flame<num_t,rand_t>> flames;
+                    for (size_t b = 0; b < blur_buckets; ++b)
+                        flames.push_back(animation.flameAt(
+                            t+dt*((b+0.5)/blur_buckets-0.5)));
+                    renderer.setMotionBlur(flames);
+                }
+            }
+            catch (...)
+            {
+                if (output_thread.joinable())
+                    output_thread.join();
+                throw;
+            }
+            render_status_t status = renderer.renderBufferParallel(samples,
+                pool->size(),batch_size,bad_value_limit);
+            if (frame_done)
+                frame_done(k,renderer,status);
+            if (output_thread.joinable())
+                output_thread.join();
+            if (!output_ok)
+                break;
+            if (output)
+                output_thread = std::thread([&output,&output_ok,&renderer,k]()
+                    { output_ok = output(k,renderer); });
+        }
+        if (output_thread.joinable())
+            output_thread.join();
+        return output_ok;
+    }
+};
+
+}
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "flame_binary.hpp"
+#include "json_small.hpp"
+#include "renderer.hpp"
+#include "thread_pool.hpp"
+#include "types.hpp"
+
+namespace tkoz
+{
+namespace flame
+{
+
+// recycles histogram buffers between renders, buffers are zeroed when they
+// are released so acquire can return them directly
+template <typename hist_t>
+class HistogramPool
+{
+private:
+    std::mutex mutex;
+    std::unordered_map<size_t,std::vector<hist_t*>> buffers; // by length
+    HistogramPool(const HistogramPool&) = delete;
+    HistogramPool& operator=(const HistogramPool&) = delete;
+public:
+    HistogramPool(){}
+    ~HistogramPool()
+    {
+        for (auto& entry : buffers)
+            for (hist_t *buf : entry.second)
+                delete[] buf;
+    }
+    // zeroed buffer of the given length
+    hist_t *acquire(size_t len)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<hist_t*>& free = buffers[len];
+        if (free.empty())
+            return new hist_t[len]();
+        hist_t *ret = free.back();
+        free.pop_back();
+        return ret;
+    }
+    // return a buffer from acquire with the same length
+    void release(hist_t *buf, size_t len)
+    {
+        std::fill(buf,buf+len,0);
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers[len].push_back(buf);
+    }
+};
+
+// one flame to render in a batch
+struct BatchJob
+{
+    Json flame;
+    std::string binary; // binary flame data, used instead of flame if set
+    std::string output;
+    size_t samples;
+    size_t size_x,size_y; // replace the flame size if nonzero
+    BatchJob(): samples(0),size_x(0),size_y(0) {}
+};
+
+/*
+renders many flames in one process with one thread pool and recycled
+histograms, jobs with at least small_samples samples are rendered one at a
+time with all threads, smaller jobs are rendered concurrently with one
+thread each
+*/
+template <typename num_t, typename hist_t, typename rand_t>
+class BatchRenderer
+{
+private:
+    typedef RendererBasic<num_t,hist_t,rand_t> renderer_t;
+    std::shared_ptr<ThreadPool> pool;
+    HistogramPool<hist_t> hist_pool;
+    std::vector<rand_t> rngs; // for each thread rendering small jobs
+    size_t oversample;
+    color_mode_t color_mode;
+    size_t small_samples;
+    size_t chains;
+    filter_t filter;
+    num_t de_max_radius,de_min_radius,de_curve;
+    BatchRenderer(const BatchRenderer&) = delete;
+    BatchRenderer& operator=(const BatchRenderer&) = delete;
+public:
+    // renderer options are the same as for RendererBasic
+    BatchRenderer(size_t threads = 1, size_t oversample = 1,
+            color_mode_t color_mode = COLOR_NONE,
+            size_t small_samples = 1 << 22,
+            std::function<void(std::thread&,size_t)> thread_callback = nullptr):
+        pool(std::make_shared<ThreadPool>(threads,thread_callback)),
+        rngs(threads),oversample(oversample),color_mode(color_mode),
+        small_samples(small_samples),chains(1),filter(FILTER_BOX),
+        de_max_radius(0.0),de_min_radius(0.0),de_curve(0.4) {}
+    inline void setFilter(filter_t filter) { this->filter = filter; }
+    // iteration chains per thread (see RendererBasic::setChains)
+    void setChains(size_t chains)
+    {
+        if (chains < 1 || chains > max_chains)
+            throw std::runtime_error("chains out of bounds");
+        this->chains = chains;
+    }
+    void setDensityEstimation(num_t max_radius, num_t min_radius = 0.0,
+        num_t curve = 0.4)
+    {
+        de_max_radius = max_radius;
+        de_min_radius = min_radius;
+        de_curve = curve;
+    }
+    // render all jobs, output(index,renderer,threads) makes the image of
+    // jobs[index] with up to threads threads and returns false if it fails
+    // done(index,error) is called after each job with an empty error if it
+    // succeeded, both may be called concurrently for small jobs
+    // returns the number of failed jobs
+    size_t render(const std::vector<BatchJob>& jobs,
+        size_t batch_size = 1 << 16, size_t bad_value_limit = 10,
+        std::function<bool(size_t,renderer_t&,size_t)> output = nullptr,
+        std::function<void(size_t,const std::string&)> done = nullptr)
+    {
+        std::atomic<size_t> failed(0);
+        // returns error message, empty if successful
+        auto render_job = [this,&jobs,&output,&batch_size,&bad_value_limit]
+            (size_t index, size_t threads, rand_t *rng)
+        {
+            const BatchJob& job = jobs[index];
+            hist_t *buf = nullptr;
+            size_t len = 0;
+            std::string error;
+            try
+            {
+                Flame<num_t,rand_t> flame = job.binary.empty()
+                    ? Flame<num_t,rand_t>(job.flame)
+                    : FlameBinary<num_t,rand_t>::decode(job.binary);
+                if (job.size_x || job.size_y)
+                    flame.setSize(job.size_x ? job.size_x : flame.getSizeX(),
+                        job.size_y ? job.size_y : flame.getSizeY());
+                len = flame.getSizeX()*flame.getSizeY()*oversample*oversample;
+                buf = hist_pool.acquire(len);
+                renderer_t renderer(flame,buf,oversample,color_mode);
+                renderer.setFilter(filter);
+                renderer.setChains(chains);
+                renderer.setDensityEstimation(de_max_radius,de_min_radius,
+                    de_curve);
+                if (rng)
+                    renderer.renderBuffer(job.samples,*rng,bad_value_limit);
+                else
+                {
+                    renderer.setThreadPool(pool);
+                    renderer.renderBufferParallel(job.samples,threads,
+                        batch_size,bad_value_limit);
+                }
+                if (output && !output(index,renderer,threads))
+                    error = "cannot write output";
+            }
+            catch (std::exception& e)
+            {
+                error = e.what();
+            }
+            if (buf)
+                hist_pool.release(buf,len);
+            return error;
+        };
+        std::vector<size_t> small;
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            if (jobs[i].samples < small_samples)
+            {
+                small.push_back(i);
+                continue;
+            }
+            std::string error = render_job(i,pool->size(),nullptr);
+            if (!error.empty())
+                ++failed;
+            if (done)
+                done(i,error);
+        }
+        std::atomic<size_t> next(0);
+        pool->run([&](size_t index)
+        {
+            for (size_t n; (n = next++) < small.size();)
+            {
+                std::string error = render_job(small[n],1,&rngs[index]);
+                if (!error.empty())
+                    ++failed;
+                if (done)
+                    done(small[n],error);
+            }
+        },std::min(pool->size(),small.size()));
+        return failed;
+    }
+};
+
+}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "json_small.hpp"
+#include "types.hpp"
+
+namespace tkoz
+{
+namespace flame
+{
+
+/*
+cache of rendered histograms (and color buffers) in a directory, keyed by
+the flame fields that affect the histogram and the render settings, so a
+render with only different image settings (scaler, bits, filter, density
+estimation) or more samples can start from the cached histogram
+file format: magic, key length (u64), key, samples (u64), histogram bytes
+(u64), color bytes (u64), histogram, color buffer (native byte order)
+*/
+class HistogramCache
+{
+private:
+    std::string dir;
+    static constexpr const char *magic = "FFHCACHE";
+    // 64 bit FNV-1a hash
+    static u64 hash(const std::string& s)
+    {
+        u64 h = 0xcbf29ce484222325uLL;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 0x100000001b3uLL;
+        }
+        return h;
+    }
+    std::string fileName(const std::string& key) const
+    {
+        char name[32];
+        snprintf(name,sizeof(name),"%016llx.hcache",
+            (unsigned long long)hash(key));
+        return dir + "/" + name;
+    }
+    // read the file header, false if it is not for key
+    static bool readHeader(std::istream& is, const std::string& key,
+        u64& samples, u64& hist_bytes, u64& color_bytes)
+    {
+        char file_magic[8];
+        u64 key_len;
+        if (!is.read(file_magic,8) || std::string(file_magic,8) != magic
+                || !is.read((char*)&key_len,8) || key_len != key.size())
+            return false;
+        std::string file_key(key_len,'\0');
+        return is.read(&file_key[0],key_len) && file_key == key
+            && is.read((char*)&samples,8) && is.read((char*)&hist_bytes,8)
+            && is.read((char*)&color_bytes,8);
+    }
+public:
+    HistogramCache(const std::string& dir): dir(dir) {}
+    // key from the flame fields used for iterating and plotting (objects
+    // are written with sorted keys so field order does not matter)
+    // num_bytes, hist_bytes are the sizes of num_t and hist_t
+    static std::string renderKey(const Json& flame, size_t oversample,
+        color_mode_t color_mode, size_t num_bytes, size_t hist_bytes)
+    {
+        static const char *fields[] = { "size_x", "size_y", "xmin", "xmax",
+            "ymin", "ymax", "xforms", "final_xform", "palette" };
+        Json key(nlohmann::json::object());
+        Json value;
+        for (const char *field : fields)
+        {
+            if (color_mode == COLOR_NONE && strcmp(field,"palette") == 0)
+                continue; // palette only matters for color
+            if (flame.valueAt(field,value))
+                key.setValue(field,value);
+        }
+        std::ostringstream os;
+        os << key << ' ' << oversample << ' ' << (int)color_mode << ' '
+            << num_bytes << ' ' << hist_bytes;
+        return os.str();
+    }
+    // read the cached buffers for key if they exist with the same sizes and
+    // at most max_samples samples, returns true and sets samples if loaded
+    // (buffers are only modified if this returns true)
+    bool load(const std::string& key, char *hist, size_t hist_bytes,
+        char *color, size_t color_bytes, size_t max_samples,
+        size_t& samples) const
+    {
+        std::ifstream ifs(fileName(key),std::ios::in|std::ios::binary);
+        u64 file_samples, file_hist_bytes, file_color_bytes;
+        if (!readHeader(ifs,key,file_samples,file_hist_bytes,file_color_bytes)
+                || file_samples > max_samples || file_hist_bytes != hist_bytes
+                || file_color_bytes != color_bytes)
+            return false;
+        std::string data(hist_bytes+color_bytes,'\0');
+        if (!ifs.read(&data[0],data.size()))
+            return false;
+        std::copy(data.begin(),data.begin()+hist_bytes,hist);
+        std::copy(data.begin()+hist_bytes,data.end(),color);
+        samples = file_samples;
+        return true;
+    }
+    // samples in the cache file for key, 0 if there is none
+    size_t cachedSamples(const std::string& key) const
+    {
+        std::ifstream ifs(fileName(key),std::ios::in|std::ios::binary);
+        u64 samples, hist_bytes, color_bytes;
+        return readHeader(ifs,key,samples,hist_bytes,color_bytes)
+            ? samples : 0;
+    }
+    // write buffers for key (replacing the file atomically)
+    bool store(const std::string& key, const char *hist, size_t hist_bytes,
+        const char *color, size_t color_bytes, size_t samples) const
+    {
+        std::string name = fileName(key);
+        std::string tmp_name = name + ".tmp";
+        std::ofstream ofs(tmp_name,std::ios::out|std::ios::binary);
+        u64 header[4] = { key.size(), samples, hist_bytes, color_bytes };
+        ofs.write(magic,8);
+        ofs.write((const char*)header,8);
+        ofs.write(key.data(),key.size());
+        ofs.write((const char*)(header+1),24);
+        ofs.write(hist,hist_bytes);
+        ofs.write(color,color_bytes);
+        ofs.close();
+        if (!ofs)
+        {
+            remove(tmp_name.c_str());
+            return false;
+        }
+        return rename(tmp_name.c_str(),name.c_str()) == 0;
+    }
+};
+
+}
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "renderer.hpp"
+#include "types.hpp"
+
+namespace tkoz
+{
+namespace flame
+{
+
+// C++ names of the template types for generated code
+template <typename T> struct type_name {};
+template <> struct type_name<float>
+{ static std::string get() { return "float"; } };
+template <> struct type_name<double>
+{ static std::string get() { return "double"; } };
+template <> struct type_name<u32>
+{ static std::string get() { return "u32"; } };
+template <> struct type_name<u64>
+{ static std::string get() { return "u64"; } };
+template <> struct type_name<JavaRandom>
+{ static std::string get() { return "JavaRandom"; } };
+template <typename word_t, size_t rparam>
+struct type_name<Isaac<word_t,rparam>>
+{
+    static std::string get()
+    {
+        return "Isaac<" + type_name<word_t>::get() + ","
+            + std::to_string(rparam) + ">";
+    }
+};
+
+/*
+compiles the xforms of a flame into a shared object with the affine
+constants, variation calls and variation parameters inlined, for long
+renders where the xform objects (a loop over the variations of each xform
+calling them through function pointers with parameters read from memory)
+are slower
+the generated source includes renderer.hpp, so the include directory must
+have the headers this program was built with (build with
+-DFLAME_INCLUDE_DIR='"/absolute/path/to/src"' if __FILE__ is a relative
+path), it is compiled with the C++ standard and defines (FLAME_PROFILE)
+of this build so IterState is the same, kernels are cached in a directory as <hash>.so (with <hash>.cpp and
+the compiler output <hash>.log) where the hash is of the source, the
+compiler command and the contents of the headers the source includes
+*/
+template <typename num_t, typename rand_t>
+class KernelCompiler
+{
+private:
+    std::string cache_dir;
+    std::string include_dir;
+    std::string compiler;
+    // 64 bit FNV-1a hash
+    static u64 hash(const std::string& s)
+    {
+        u64 h = 0xcbf29ce484222325uLL;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 0x100000001b3uLL;
+        }
+        return h;
+    }
+    // exact num_t literal
+    static std::string literal(num_t value)
+    {
+        char buf[64];
+        snprintf(buf,sizeof(buf),"(num_t)(%a)",(double)value);
+        return buf;
+    }
+    // same expression as Affine2D::apply_to
+    static std::string affine(const Affine2D<num_t>& A, const char *p)
+    {
+        std::ostringstream os;
+        os << "Point2D<num_t>(" << literal(A.a) << "*" << p << ".x+"
+            << literal(A.b) << "*" << p << ".y+" << literal(A.c) << ",\n"
+            << "        " << literal(A.d) << "*" << p << ".x+"
+            << literal(A.e) << "*" << p << ".y+" << literal(A.f) << ")";
+        return os.str();
+    }
+    // same steps as XForm::applyIteration
+    static void putXForm(std::ostream& os, const XForm<num_t,rand_t>& xf,
+        const std::string& name)
+    {
+        const std::vector<num_t>& varp = xf.getVariationParams();
+        os << "static inline void " << name << "(state_t& state)\n{\n";
+        if (!varp.empty())
+        {
+            os << "    static const num_t params[] = {";
+            for (size_t i = 0; i < varp.size(); ++i)
+                os << (i ? "," : "") << "\n        " << literal(varp[i]);
+            os << " };\n";
+        }
+        os << "    state.t = " << affine(xf.getPreAffine(),"state.p") << ";\n";
+        os << "    state.v = Point2D<num_t>(0.0,0.0);\n";
+        for (const XFormVar<num_t,rand_t>& var : xf.getVariations())
+            os << "    var_" << vars<num_t,rand_t>::data[var.id].name
+                << "<num_t,rand_t>(state,params+"
+                << var.index << ");\n";
+        os << "    state.p = " << affine(xf.getPostAffine(),"state.v")
+            << ";\n}\n\n";
+    }
+    // append the contents of a header and of the headers it includes with
+    // #include "...", each once, false if one cannot be read
+    static bool readHeaders(const std::string& path,
+        std::set<std::string>& seen, std::string& out)
+    {
+        if (!seen.insert(path).second)
+            return true;
+        std::ifstream ifs(path);
+        if (!ifs)
+            return false;
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? ""
+            : path.substr(0,slash+1);
+        std::string line;
+        while (std::getline(ifs,line))
+        {
+            out += line;
+            out += '\n';
+            size_t i = line.find_first_not_of(" \t");
+            if (i == std::string::npos || line.compare(i,8,"#include") != 0)
+                continue;
+            size_t begin = line.find('"',i+8);
+            size_t end = begin == std::string::npos ? begin
+                : line.find('"',begin+1);
+            if (end == std::string::npos)
+                continue; // system header
+            if (!readHeaders(dir + line.substr(begin+1,end-begin-1),seen,out))
+                return false;
+        }
+        return true;
+    }
+    // flags for the C++ standard and the defines this program was built
+    // with that change the headers
+    static std::string buildFlags()
+    {
+#ifdef __STRICT_ANSI__
+        std::string flags = "-std=c++";
+#else
+        std::string flags = "-std=gnu++";
+#endif
+        flags += __cplusplus >= 202002L ? "20" : __cplusplus >= 201703L
+            ? "17" : "14";
+#ifdef FLAME_PROFILE
+        flags += " -DFLAME_PROFILE";
+#endif
+        return flags;
+    }
+    // the command is part of the cache key
+    std::string command(const std::string& src, const std::string& out,
+        const std::string& log) const
+    {
+        return compiler + " " + buildFlags() + " -fPIC -shared -I'"
+            + include_dir + "' -o '" + out + "' '" + src + "' 2> '" + log
+            + "'";
+    }
+    // open a compiled kernel, false if it cannot be loaded
+    static bool load(const std::string& path, IterKernel<num_t,rand_t>& kernel,
+        bool has_final)
+    {
+        void *handle = dlopen(path.c_str(),RTLD_NOW|RTLD_LOCAL);
+        if (!handle)
+            return false;
+        std::shared_ptr<void> library(handle,[](void *h) { dlclose(h); });
+        IterKernel<num_t,rand_t> ret;
+        ret.iterate = (u32(*)(IterState<num_t,rand_t>&))
+            dlsym(handle,"flame_kernel_iterate");
+        if (has_final)
+            ret.apply_final = (void(*)(IterState<num_t,rand_t>&))
+                dlsym(handle,"flame_kernel_final");
+        if (!ret.iterate || (has_final && !ret.apply_final))
+            return false;
+        ret.library = library;
+        kernel = ret;
+        return true;
+    }
+public:
+    // directory containing the headers, FLAME_INCLUDE_DIR if defined or
+    // else the directory of this file (only correct from any working
+    // directory if the compiler was given an absolute path)
+    static std::string defaultIncludeDir()
+    {
+#ifdef FLAME_INCLUDE_DIR
+        return FLAME_INCLUDE_DIR;
+#else
+        std::string file = __FILE__;
+        size_t slash = file.rfind('/');
+        return slash == std::string::npos ? "." : file.substr(0,slash);
+#endif
+    }
+    KernelCompiler(const std::string& cache_dir,
+            const std::string& include_dir = defaultIncludeDir(),
+            const std::string& compiler = "g++ -O3"):
+        cache_dir(cache_dir),include_dir(include_dir),compiler(compiler) {}
+    // C++ source of the kernel for a flame, defines extern "C" functions
+    // flame_kernel_iterate and flame_kernel_final (see IterKernel)
+    static std::string source(const Flame<num_t,rand_t>& flame)
+    {
+        const std::vector<XForm<num_t,rand_t>>& xfs = flame.getXForms();
+        std::vector<num_t> cw = flame.getCumulativeWeights();
+        std::ostringstream os;
+        os << "// iteration kernel generated by codegen.hpp\n"
+            << "#include \"renderer.hpp\"\n\n"
+            << "using namespace tkoz::flame;\n"
+            << "typedef " << type_name<num_t>::get() << " num_t;\n"
+            << "typedef " << type_name<rand_t>::get() << " rand_t;\n"
+            << "typedef IterState<num_t,rand_t> state_t;\n\n";
+        for (size_t i = 0; i < xfs.size(); ++i)
+            putXForm(os,xfs[i],"xform_" + std::to_string(i));
+        if (flame.hasFinalXForm())
+            putXForm(os,flame.getFinalXForm(),"xform_final");
+        // same selection as IterState::randXFormIndex
+        os << "extern \"C\" u32 flame_kernel_iterate(state_t& state)\n{\n"
+            << "    static const num_t cw[] = {";
+        for (size_t i = 0; i < cw.size(); ++i)
+            os << (i ? "," : "") << "\n        " << literal(cw[i]);
+        os << " };\n"
+            << "    u32 i = 0;\n"
+            << "    num_t r = state.randNum();\n"
+            << "    while (cw[i] < r)\n"
+            << "        ++i;\n"
+            << "    switch (i)\n    {\n";
+        for (size_t i = 0; i+1 < xfs.size(); ++i)
+            os << "    case " << i << ": xform_" << i << "(state); break;\n";
+        os << "    default: xform_" << xfs.size()-1 << "(state); break;\n"
+            << "    }\n    return i;\n}\n";
+        if (flame.hasFinalXForm())
+            os << "\nextern \"C\" void flame_kernel_final(state_t& state)\n"
+                << "{ xform_final(state); }\n";
+        return os.str();
+    }
+    // load the kernel for a flame from the cache directory, compiling it
+    // if it is not there, returns false and sets error if it fails (then
+    // render with the xform objects)
+    bool compile(const Flame<num_t,rand_t>& flame,
+        IterKernel<num_t,rand_t>& kernel, std::string& error) const
+    {
+        std::string src = source(flame);
+        std::string headers;
+        std::set<std::string> seen;
+        if (!readHeaders(include_dir + "/renderer.hpp",seen,headers))
+        {
+            error = "cannot read the headers in " + include_dir;
+            return false;
+        }
+        char name[32];
+        snprintf(name,sizeof(name),"%016llx",(unsigned long long)hash(src
+            + command("","","") + "\n" + headers));
+        std::string base = cache_dir + "/" + name;
+        if (load(base + ".so",kernel,flame.hasFinalXForm()))
+            return true;
+        if (mkdir(cache_dir.c_str(),0777) < 0 && errno != EEXIST)
+        {
+            error = "cannot create kernel cache directory";
+            return false;
+        }
+        std::ofstream ofs(base + ".cpp");
+        ofs << src;
+        ofs.close();
+        if (!ofs)
+        {
+            error = "cannot write kernel source";
+            return false;
+        }
+        // compile to a temporary file so other processes only see complete
+        // kernels
+        std::string tmp = base + "." + std::to_string(getpid()) + ".tmp";
+        if (system(command(base + ".cpp",tmp,base + ".log").c_str()) != 0)
+        {
+            remove(tmp.c_str());
+            error = "kernel compile failed, see " + base + ".log";
+            return false;
+        }
+        if (rename(tmp.c_str(),(base + ".so").c_str()) != 0)
+        {
+            remove(tmp.c_str());
+            error = "cannot write kernel";
+            return false;
+        }
+        if (!load(base + ".so",kernel,flame.hasFinalXForm()))
+        {
+            error = "cannot load kernel " + base + ".so";
+            return false;
+        }
+        return true;
+    }
+};
+
+}
+}
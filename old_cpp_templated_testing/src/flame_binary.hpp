@@ -0,0 +1,326 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "renderer.hpp"
+#include "types.hpp"
+#include "variations.hpp"
+
+namespace tkoz
+{
+namespace flame
+{
+
+/*
+precompiled binary flame, made from a parsed flame so loading it skips JSON
+parsing and variation parameter parsing, variation names are stored once in
+a table and resolved once per file
+encode a Flame<double,rand_t> so the file loads without rounding at either
+precision (a float flame stores float rounded values)
+file format (native byte order, numbers are double regardless of num_t):
+    header: magic, version (u32), flags (u32, 1 = final xform, 2 = palette),
+        file size (u64), FNV-1a hash of the rest of the file (u64)
+    size_x, size_y (u64), xmin, xmax, ymin, ymax (double)
+    name (u32 length, bytes)
+    variation names (u32 count, each is u32 length, bytes)
+    xforms (u32 count, each as below, then the final xform if flags has 1)
+        weight, color, color_speed (double), has_pre, has_post, has_color (u8)
+        pre affine, post affine (6 double each)
+        variations (u32 count, each is u32 name index, u32 parameter index)
+        parameters (u32 count, double each, as stored by the variation parser)
+    palette if flags has 2 (palette_size rgb u8 triples, interpolated)
+*/
+template <typename num_t, typename rand_t>
+class FlameBinary
+{
+private:
+    static constexpr const char *magic = "FFBINARY";
+    static const u32 version = 1;
+    static const size_t header_size = 32;
+    static const u32 FLAG_FINAL_XFORM = 1;
+    static const u32 FLAG_PALETTE = 2;
+    static u64 hash(const char *data, size_t len)
+    {
+        u64 h = 0xcbf29ce484222325uLL;
+        for (size_t i = 0; i < len; ++i)
+        {
+            h ^= (unsigned char)data[i];
+            h *= 0x100000001b3uLL;
+        }
+        return h;
+    }
+    template <typename T> static void put(std::string& out, T value)
+    { out.append((const char*)&value,sizeof(T)); }
+    static void putString(std::string& out, const std::string& s)
+    {
+        put<u32>(out,s.size());
+        out += s;
+    }
+    // bounds checked reading from the file data
+    struct Reader
+    {
+        const char *ptr,*end;
+        template <typename T> T get()
+        {
+            if ((size_t)(end-ptr) < sizeof(T))
+                throw std::runtime_error("binary flame is truncated");
+            T value;
+            memcpy(&value,ptr,sizeof(T));
+            ptr += sizeof(T);
+            return value;
+        }
+        std::string getString()
+        {
+            u32 len = get<u32>();
+            if ((size_t)(end-ptr) < len)
+                throw std::runtime_error("binary flame is truncated");
+            std::string ret(ptr,len);
+            ptr += len;
+            return ret;
+        }
+        num_t getNum()
+        {
+            double value = get<double>();
+            if (!std::isfinite(value))
+                throw std::runtime_error("binary flame number is not finite");
+            return value;
+        }
+    };
+    static void putXForm(std::string& out, const XForm<num_t,rand_t>& xf,
+        std::unordered_map<var_id_t,u32>& names)
+    {
+        put<double>(out,xf.weight);
+        put<double>(out,xf.color);
+        put<double>(out,xf.color_speed);
+        put<u8>(out,xf.has_pre);
+        put<u8>(out,xf.has_post);
+        put<u8>(out,xf.has_color);
+        for (const Affine2D<num_t>& A : { xf.pre, xf.post })
+            for (num_t a : { A.a, A.b, A.c, A.d, A.e, A.f })
+                put<double>(out,a);
+        put<u32>(out,xf.vars.size());
+        for (const XFormVar<num_t,rand_t>& var : xf.vars)
+        {
+            put<u32>(out,names.at(var.id));
+            put<u32>(out,var.index);
+        }
+        put<u32>(out,xf.varp.size());
+        for (num_t p : xf.varp)
+            put<double>(out,p);
+    }
+    static XForm<num_t,rand_t> getXForm(Reader& in,
+        const std::vector<var_id_t>& table, bool is_final)
+    {
+        XForm<num_t,rand_t> xf;
+        xf.weight = in.getNum();
+        xf.color = in.getNum();
+        xf.color_speed = in.getNum();
+        xf.has_pre = in.template get<u8>();
+        xf.has_post = in.template get<u8>();
+        xf.has_color = in.template get<u8>();
+        if (!is_final && xf.weight <= 0.0)
+            throw std::runtime_error("weights must be positive");
+        if (xf.color < 0.0 || xf.color > 1.0)
+            throw std::runtime_error("color must be in [0,1]");
+        if (xf.color_speed < 0.0 || xf.color_speed > 1.0)
+            throw std::runtime_error("color_speed must be in [0,1]");
+        num_t A[12];
+        for (size_t i = 0; i < 12; ++i)
+            A[i] = in.getNum();
+        xf.pre = Affine2D<num_t>(A[0],A[1],A[2],A[3],A[4],A[5]);
+        xf.post = Affine2D<num_t>(A[6],A[7],A[8],A[9],A[10],A[11]);
+        u32 var_count = in.template get<u32>();
+        for (u32 i = 0; i < var_count; ++i)
+        {
+            u32 name_index = in.template get<u32>();
+            if (name_index >= table.size())
+                throw std::runtime_error("binary flame variation index");
+            XFormVar<num_t,rand_t> var;
+            var.id = table[name_index];
+            var.func = vars<num_t,rand_t>::data[var.id].func;
+            var.index = in.template get<u32>();
+            xf.vars.push_back(var);
+        }
+        u32 param_count = in.template get<u32>();
+        // every parameter a variation reads must be in the file
+        for (const XFormVar<num_t,rand_t>& var : xf.vars)
+            if (var.index > param_count || param_count-var.index
+                    < vars<num_t,rand_t>::data[var.id].param_count)
+                throw std::runtime_error("binary flame parameter index");
+        for (u32 i = 0; i < param_count; ++i)
+            xf.varp.push_back(in.getNum());
+        return xf;
+    }
+public:
+    // true if data starts like a binary flame
+    static bool isBinary(const char *data, size_t len)
+    { return len >= 8 && memcmp(data,magic,8) == 0; }
+    static bool isBinary(const std::string& data)
+    { return isBinary(data.data(),data.size()); }
+    // true if the file starts like a binary flame
+    static bool isBinaryFile(const std::string& name)
+    {
+        char data[8];
+        std::ifstream ifs(name,std::ios::in|std::ios::binary);
+        return ifs.read(data,8) && isBinary(data,8);
+    }
+    // encode a flame
+    static std::string encode(const Flame<num_t,rand_t>& flame)
+    {
+        std::unordered_map<var_id_t,u32> names;
+        std::vector<var_id_t> name_list;
+        auto add_names = [&names,&name_list](const XForm<num_t,rand_t>& xf)
+        {
+            for (const XFormVar<num_t,rand_t>& var : xf.vars)
+                if (names.insert(std::make_pair(var.id,name_list.size()))
+                        .second)
+                    name_list.push_back(var.id);
+        };
+        for (const XForm<num_t,rand_t>& xf : flame.xforms)
+            add_names(xf);
+        if (flame.has_final_xform)
+            add_names(flame.final_xform);
+        std::string out(header_size,'\0');
+        put<u64>(out,flame.size_x);
+        put<u64>(out,flame.size_y);
+        put<double>(out,flame.xmin);
+        put<double>(out,flame.xmax);
+        put<double>(out,flame.ymin);
+        put<double>(out,flame.ymax);
+        putString(out,flame.name);
+        put<u32>(out,name_list.size());
+        for (var_id_t id : name_list)
+            putString(out,vars<num_t,rand_t>::data[id].name);
+        put<u32>(out,flame.xforms.size());
+        for (const XForm<num_t,rand_t>& xf : flame.xforms)
+            putXForm(out,xf,names);
+        if (flame.has_final_xform)
+            putXForm(out,flame.final_xform,names);
+        if (flame.has_palette)
+            for (const rgb_t<u8>& c : flame.palette)
+            {
+                put<u8>(out,c.r);
+                put<u8>(out,c.g);
+                put<u8>(out,c.b);
+            }
+        u32 flags = (flame.has_final_xform ? FLAG_FINAL_XFORM : 0)
+            | (flame.has_palette ? FLAG_PALETTE : 0);
+        u64 header[2] = { out.size(),
+            hash(out.data()+header_size,out.size()-header_size) };
+        memcpy(&out[0],magic,8);
+        memcpy(&out[8],&version,4);
+        memcpy(&out[12],&flags,4);
+        memcpy(&out[16],header,16);
+        return out;
+    }
+    // decode a flame, throws error if the data is not a valid binary flame
+    static Flame<num_t,rand_t> decode(const char *data, size_t len)
+    {
+        if (!isBinary(data,len) || len < header_size)
+            throw std::runtime_error("not a binary flame");
+        u32 file_version, flags;
+        u64 header[2];
+        memcpy(&file_version,data+8,4);
+        memcpy(&flags,data+12,4);
+        memcpy(header,data+16,16);
+        if (file_version != version)
+            throw std::runtime_error("unsupported binary flame version");
+        if (header[0] != len)
+            throw std::runtime_error("binary flame size is wrong");
+        if (header[1] != hash(data+header_size,len-header_size))
+            throw std::runtime_error("binary flame is corrupted");
+        Reader in{data+header_size,data+len};
+        Flame<num_t,rand_t> flame;
+        u64 size_x = in.template get<u64>();
+        u64 size_y = in.template get<u64>();
+        flame.setSize(size_x,size_y);
+        num_t xmin = in.getNum(), xmax = in.getNum();
+        num_t ymin = in.getNum(), ymax = in.getNum();
+        flame.setBounds(xmin,xmax,ymin,ymax);
+        flame.name = in.getString();
+        // resolve variation names once
+        std::vector<var_id_t> table;
+        u32 name_count = in.template get<u32>();
+        for (u32 i = 0; i < name_count; ++i)
+        {
+            var_id_t id;
+            if (!vars<num_t,rand_t>::find(in.getString(),id))
+                throw std::runtime_error("unknown variation");
+            table.push_back(id);
+        }
+        u32 xform_count = in.template get<u32>();
+        if (xform_count == 0)
+            throw std::runtime_error("binary flame has no xforms");
+        for (u32 i = 0; i < xform_count; ++i)
+            flame.xforms.push_back(getXForm(in,table,false));
+        flame.has_final_xform = flags & FLAG_FINAL_XFORM;
+        if (flame.has_final_xform)
+            flame.final_xform = getXForm(in,table,true);
+        flame.has_palette = flags & FLAG_PALETTE;
+        if (flame.has_palette)
+            for (size_t i = 0; i < palette_size; ++i)
+            {
+                u8 r = in.template get<u8>();
+                u8 g = in.template get<u8>();
+                u8 b = in.template get<u8>();
+                flame.palette.push_back(rgb_t<u8>(r,g,b));
+            }
+        if (in.ptr != in.end)
+            throw std::runtime_error("binary flame has extra data");
+        return flame;
+    }
+    static Flame<num_t,rand_t> decode(const std::string& data)
+    { return decode(data.data(),data.size()); }
+    // read a binary flame file (memory mapped)
+    static Flame<num_t,rand_t> readFile(const std::string& name)
+    {
+        int fd = open(name.c_str(),O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open binary flame");
+        struct stat st;
+        if (fstat(fd,&st) < 0 || st.st_size == 0)
+        {
+            close(fd);
+            throw std::runtime_error("cannot read binary flame");
+        }
+        void *data = mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+        close(fd);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("cannot read binary flame");
+        try
+        {
+            Flame<num_t,rand_t> flame = decode((const char*)data,st.st_size);
+            munmap(data,st.st_size);
+            return flame;
+        }
+        catch (...)
+        {
+            munmap(data,st.st_size);
+            throw;
+        }
+    }
+    // write a binary flame file, returns false if it fails
+    static bool writeFile(const std::string& name,
+        const Flame<num_t,rand_t>& flame)
+    {
+        std::string data = encode(flame);
+        std::ofstream ofs(name,std::ios::out|std::ios::binary);
+        ofs.write(data.data(),data.size());
+        ofs.close();
+        return ofs.good();
+    }
+};
+
+}
+}
@@ -1,151 +1,244 @@
 #include "json_small.hpp"
 
-Json::Json()
+// shared null value for default constructed objects
+static const std::shared_ptr<nlohmann::json>& null_root()
+{
+    static const std::shared_ptr<nlohmann::json> root =
+        std::make_shared<nlohmann::json>();
+    return root;
+}
+
+Json::Json(): root(null_root()), node(root.get())
 {
 }
 
 Json::Json(std::istream& input):
-        nlohmann::json(nlohmann::json::parse(input,nullptr,true,true))
+        root(std::make_shared<nlohmann::json>(
+            nlohmann::json::parse(input,nullptr,true,true))),
+        node(root.get())
 {
 }
 
 Json::Json(const std::string& input):
-        nlohmann::json(nlohmann::json::parse(input,nullptr,true,true))
+        root(std::make_shared<nlohmann::json>(
+            nlohmann::json::parse(input,nullptr,true,true))),
+        node(root.get())
+{
+}
+
+Json::Json(const nlohmann::json& input):
+        root(std::make_shared<nlohmann::json>(input)), node(root.get())
 {
 }
 
-Json::Json(const nlohmann::json& input): nlohmann::json(input)
+Json::Json(const std::shared_ptr<nlohmann::json>& root,
+        const nlohmann::json *node): root(root), node(node)
 {
 }
 
+nlohmann::json& Json::mutableNode()
+{
+    if (root.use_count() != 1 || node != root.get())
+    {
+        root = std::make_shared<nlohmann::json>(*node);
+        node = root.get();
+    }
+    return *root;
+}
+
 bool Json::isNull() const
 {
-    return this->is_null();
+    return node->is_null();
 }
 
 bool Json::isBool() const
 {
-    return this->is_boolean();
+    return node->is_boolean();
 }
 
 bool Json::isInt() const
 {
-    return this->is_number_integer();
+    return node->is_number_integer();
 }
 
 bool Json::isFloat() const
 {
-    return this->is_number_float();
+    return node->is_number_float();
 }
 
 bool Json::isString() const
 {
-    return this->is_string();
+    return node->is_string();
 }
 
 bool Json::isArray() const
 {
-    return this->is_array();
+    return node->is_array();
 }
 
 bool Json::isObject() const
 {
-    return this->is_object();
+    return node->is_object();
 }
 
 bool Json::boolValue() const
 {
-    return this->get<bool>();
+    return node->get<bool>();
 }
 
 int64_t Json::intValue() const
 {
-    return this->get<int64_t>();
+    return node->get<int64_t>();
 }
 
 double Json::floatValue() const
 {
-    return this->get<double>();
+    return node->get<double>();
 }
 
 std::string Json::stringValue() const
 {
-    return this->get<std::string>();
+    return node->get<std::string>();
 }
 
 JsonArray Json::arrayValue() const
 {
-    auto tmp1 = this->get<std::vector<nlohmann::json>>();
-    JsonArray tmp2;
-    tmp2.reserve(tmp1.size());
-    for (size_t i = 0; i < tmp1.size(); ++i)
-        tmp2.push_back(Json(tmp1[i]));
-    return tmp2;
+    if (!node->is_array())
+        throw nlohmann::json::type_error::create(302,
+            std::string("type must be array, but is ") + node->type_name(),
+            node);
+    JsonArray ret;
+    ret.reserve(node->size());
+    for (const nlohmann::json& value : *node)
+        ret.push_back(view(value));
+    return ret;
+}
+
+size_t Json::size() const
+{
+    return node->size();
 }
 
 JsonObject Json::objectValue() const
 {
-    auto tmp1 = this->get<std::unordered_map<std::string,nlohmann::json>>();
-    JsonObject tmp2;
-    tmp2.reserve(tmp1.size());
-    for (auto iter = tmp1.begin(); iter != tmp1.end(); ++iter)
-        tmp2.insert(std::make_pair(iter->first,Json(iter->second)));
-    return tmp2;
+    if (!node->is_object())
+        throw nlohmann::json::type_error::create(302,
+            std::string("type must be object, but is ") + node->type_name(),
+            node);
+    JsonObject ret;
+    ret.reserve(node->size());
+    for (auto iter = node->begin(); iter != node->end(); ++iter)
+        ret.insert(std::make_pair(iter.key(),view(iter.value())));
+    return ret;
 }
 
 bool Json::valueAt(size_t index, Json& value) const
 {
-    if (!this->is_array() || index >= this->size())
+    if (!node->is_array() || index >= node->size())
         return false;
-    value = Json(this->at(index));
+    value = view((*node)[index]);
     return true;
 }
 
 bool Json::valueAt(const std::string& key, Json& value) const
 {
-    if (!this->is_object() || this->find(key) == this->end())
+    if (!node->is_object())
         return false;
-    value = Json(this->at(key));
+    auto iter = node->find(key);
+    if (iter == node->end())
+        return false;
+    value = view(*iter);
     return true;
 }
 
 bool Json::valueAt(const char *key, Json& value) const
 {
-    if (!this->is_object() || this->find(key) == this->end())
+    if (!node->is_object())
+        return false;
+    auto iter = node->find(key);
+    if (iter == node->end())
         return false;
-    value = Json(this->at(key));
+    value = view(*iter);
     return true;
 }
 
-Json Json::operator[](size_t index) const
+bool Json::setValue(const std::string& key, const Json& value)
 {
-    return Json(this->at(index));
+    if (!node->is_object())
+        return false;
+    nlohmann::json copy = *value.node; // value may be in this tree
+    mutableNode()[key] = std::move(copy);
+    return true;
 }
 
-Json Json::operator[](const std::string& key) const
+bool Json::append(const Json& value)
 {
-    return Json(this->at(key));
+    if (!node->is_array())
+        return false;
+    nlohmann::json copy = *value.node;
+    mutableNode().push_back(std::move(copy));
+    return true;
 }
 
-Json Json::operator[](const char *key) const
+static nlohmann::json interpolate_json(const nlohmann::json& a,
+    const nlohmann::json& b, double t)
+{
+    if (a.is_number() && b.is_number())
+    {
+        if (a.is_number_integer() && b.is_number_integer() && a == b)
+            return a; // keep integers that do not change
+        return (1.0-t)*a.get<double>() + t*b.get<double>();
+    }
+    if (a.type() != b.type())
+        throw std::runtime_error("interpolating different JSON types");
+    if (a.is_array())
+    {
+        if (a.size() != b.size())
+            throw std::runtime_error("interpolating different array lengths");
+        nlohmann::json ret = nlohmann::json::array();
+        for (size_t i = 0; i < a.size(); ++i)
+            ret.push_back(interpolate_json(a[i],b[i],t));
+        return ret;
+    }
+    if (a.is_object())
+    {
+        nlohmann::json ret = a;
+        for (auto iter = a.begin(); iter != a.end(); ++iter)
+            if (b.contains(iter.key()))
+                ret[iter.key()] = interpolate_json(iter.value(),
+                    b[iter.key()],t);
+        return ret;
+    }
+    return a;
+}
+
+Json Json::interpolate(const Json& other, double t) const
+{
+    return Json(interpolate_json(*node,*other.node,t));
+}
+
+Json Json::operator[](size_t index) const
 {
-    return Json(this->at(key));
+    return view(node->at(index));
 }
 
-Json& Json::operator=(const Json& a)
+Json Json::operator[](const std::string& key) const
+{
+    return view(node->at(key));
+}
+
+Json Json::operator[](const char *key) const
 {
-    static_cast<nlohmann::json&>(*this) = static_cast<const nlohmann::json&>(a);
-    return *this;
+    return view(node->at(key));
 }
 
 bool Json::operator==(const Json& a)
 {
-    return static_cast<const nlohmann::json&>(*this) \
-        == static_cast<const nlohmann::json&>(a);
+    return *node == *a.node;
 }
 
 std::ostream& operator<<(std::ostream& os, const Json& json)
 {
-    os << static_cast<const nlohmann::json&>(json);
+    os << *json.node;
     return os;
 }
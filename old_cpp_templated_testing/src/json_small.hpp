@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
@@ -17,9 +18,21 @@ typedef std::unordered_map<std::string,Json> JsonObject;
 /*
 interface for using nlohmann::json with the features needed for this project
 supports comments in JSON
+values returned from accessors are views sharing the parsed tree, so they
+are not copied, a view is only copied when it is modified (setValue, append)
 */
-class Json: private nlohmann::json
+class Json
 {
+private:
+    std::shared_ptr<nlohmann::json> root; // tree shared with other views
+    const nlohmann::json *node; // value in the root tree
+    Json(const std::shared_ptr<nlohmann::json>& root,
+        const nlohmann::json *node);
+    // view of a value in the same tree
+    inline Json view(const nlohmann::json& value) const
+    { return Json(root,&value); }
+    // node that can be modified, copies it first if it is shared
+    nlohmann::json& mutableNode();
 public:
     // create json object from input stream or string
     // create empty JSON
@@ -54,6 +67,8 @@ public:
     std::string stringValue() const;
     // returns array value, exception if not an array
     JsonArray arrayValue() const;
+    // number of array or object elements, 0 for null, 1 for other values
+    size_t size() const;
     // returns object value, exception if not an object
     JsonObject objectValue() const;
     // if this is a long enough array, sets value and returns true
@@ -62,14 +77,19 @@ public:
     bool valueAt(const std::string& key, Json& value) const;
     // if this is an object with the given key, sets value and returns true
     bool valueAt(const char *key, Json& value) const;
+    // if this is an object, sets key to value and returns true
+    bool setValue(const std::string& key, const Json& value);
+    // if this is an array, appends value and returns true
+    bool append(const Json& value);
+    // linear interpolation (1-t)*this + t*other of all numbers, other values
+    // are copied from this, exception if array lengths or types differ
+    Json interpolate(const Json& other, double t) const;
     // access array index, exception if not an array or not long enough
     Json operator[](size_t index) const;
     // access object key, exception if not an object or does not have key
     Json operator[](const std::string& key) const;
     // access object key, exception if not an object or does not have key
     Json operator[](const char *key) const;
-    // assignment operator
-    Json& operator=(const Json& a);
     // compare equality of JSON objects
     bool operator==(const Json& a);
     // use nlohmann::json output stream operator
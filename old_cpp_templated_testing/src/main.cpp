@@ -1,100 +1,225 @@
 /*
 ffgray: usage
 [-h --help]: show this message
--f --flame: flame parameters JSON file (required)
--o --output: output file (required)
+-f --flame: flame parameters JSON or binary flame file (required unless
+    batch/server)
+-o --output: output file (required unless batch/server/compile)
 [-i --input]: buffer (default none, render new buffer)
 [-s --samples]: samples to render (default 0)
-[-t --type]: output type (png,pgm,buf) (default use file extension)
+[-t --type]: output type (png,pgm,ppm,buf) (default use file extension)
 [-b --img_bits]: bit depth for png or pgm output (8 or 16) (default 8)
 [-T --threads]: number of threads to use (default 1)
 [-z --batch_size]: multithreading batch size (default 250000)
 [-B --bad_values]: bad value limit for terminating render (default 10)
 [-m --scaler]: scaling function for image (binary,linear,log) (default log)
-
-planned options (not available yet):
+[-L --png_level]: png compression level (0-9) (default 6)
+[-F --png_filter]: png filter (none,sub,up,avg,paeth,all) (default all)
+[-S --oversample]: histogram subpixels per image pixel (1-16) (default 1)
+[-k --filter]: downsampling filter (box,gaussian) (default gaussian)
+[-d --de_radius]: density estimation max kernel radius (default 0, disabled)
+[--de_min_radius]: density estimation min kernel radius (default 0)
+[--de_curve]: density estimation kernel radius curve (default 0.4)
+[-c --color]: render color using the flame palette (buffer includes colors)
+[-C --color_mode]: color accumulation (index,rgb) (default index), rgb
+    averages exact colors but is slower
+[--check_interval]: samples between early termination checks (default 2^24)
+[--min_plot_ratio]: stop if plotted/iterated is below (default 0, disabled)
+[--converge]: stop if relative image change per check is below (default 0)
+[--max_bad_rate]: stop if bad values/iterated is above (default 0, disabled)
+[--shrink]: multiply the remaining samples by this instead of stopping when
+    the min_plot_ratio or max_bad_rate check fails (default 0, stop)
+[-a --frame]: samples for finding flame bounds before render (default 0, off)
+[--frame_quantile]: fraction of outliers ignored per side (default 0.001)
+[--frame_json]: write flame JSON with the found bounds to this file
+[-n --frames]: render an animation of this many frames from keyframes in the
+    flame JSON, frame numbers are added to the output name (default 0, off)
+[--shutter]: animation motion blur time as a fraction of the frame interval
+    (default 0, disabled)
+[--blur_buckets]: motion blur times per frame (default 16)
+[--batch]: JSONL manifest of flames to render, each line is an object with
+    "flame" (JSON or binary flame path), "output" (png/pgm/ppm path),
+    optional "samples" (default --samples) and optional "size_x","size_y"
+    replacing the flame size
+[--batch_small]: batch jobs with fewer samples are rendered concurrently
+    with 1 thread each (default 2^22)
+[--server]: serve render requests on this UNIX socket path (- for stdin and
+    stdout), see server.hpp for the protocol
+[--cache]: directory of cached histograms, a render of the same flame and
+    settings starts from the cached histogram if it has at most --samples
+    samples and renders the rest (then updates the cache)
+[-P --preview]: preview image (png or pgm) updated during render (default none)
+[--preview_interval]: seconds between preview images (default 60)
+[--preview_size]: max preview width/height (default 256)
+[--compile]: write the flame (with bounds from --frame) as a binary flame
+    file instead of rendering, see flame_binary.hpp for the format
 [-p --precision]: calculation precision (single or double) (default single)
 [-w --hist_bits]: histogram integer bit size (32 or 64) (default 32)
 [-R --rng]: random number generator (java,isaac32,isaac64) (default isaac32)
+[--bench_types]: render the flame (--samples, --threads) with every
+    precision/hist_bits/rng and print the samples/sec of each
+[--mixed]: single precision iteration with plotted points recomputed in
+    double from this many iterations before them (1-64), for zoomed views
+    that are too coarse in single precision (default 0, off)
+[--chains]: independent iteration chains interleaved by each thread (1-8)
+    (default 1)
+[--kernel]: directory to cache iteration kernels compiled for the flame
+    (g++ and the headers are needed), renders with the xform objects if it
+    cannot be compiled (default none)
+[--kernel_include]: directory with the headers for compiling kernels
+    (default the source directory at build time, set with
+    -DFLAME_INCLUDE_DIR if the build uses relative paths)
+[--profile_json]: write the xform and variation profile to this file
+    (requires building with -DFLAME_PROFILE, which also prints it with the
+    render statistics) (default none)
+
+planned options (not available yet):
 [-r --seed]: random number generator seed seed (default random)
 */
 
+#include <chrono>
+#include <condition_variable>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 
 #include <boost/program_options.hpp>
 
+#include "animation.hpp"
+#include "batch.hpp"
+#include "cache.hpp"
+#include "codegen.hpp"
+#include "flame_binary.hpp"
 #include "json_small.hpp"
 #include "renderer.hpp"
+#include "server.hpp"
 #include "types.hpp"
 #include "variations.hpp"
 #include "utils.hpp"
 
 namespace bpo = boost::program_options;
-typedef float num_t; // can also be double (slower)
-typedef Isaac<u32,4> rand_t; // can also be JavaRandom (about same speed)
 
-int main(int argc, char **argv)
+// profile of the rendered xforms (see tkoz::flame::profile_enabled) with
+// ticks per call averaged over the timed iterations (null if none, such as
+// variations in a compiled kernel)
+template <typename num_t, typename hist_t, typename rand_t>
+nlohmann::json profile_json(
+    const tkoz::flame::RendererBasic<num_t,hist_t,rand_t>& renderer)
 {
-    bpo::options_description options("ffgray: usage");
-    options.add_options()
-        ("help,h","show this message")
-        ("flame,f",bpo::value<std::string>(),
-            "flame parameters JSON file (required)")
-        ("output,o",bpo::value<std::string>(),
-            "output file (required)")
-        ("input,i",bpo::value<std::string>()->default_value(""),
-            "buffer (default none, render new buffer)")
-        ("samples,s",bpo::value<size_t>()->default_value(0),
-            "samples to render (default 0)")
-        ("type,t",bpo::value<std::string>()->default_value(""),
-            "output type (png,pgm,buf) (default use file extension)")
-        ("img_bits,b",bpo::value<size_t>()->default_value(8),
-            "bit depth for png or pgm output (8 or 16) (default 8)")
-        ("threads,T",bpo::value<size_t>()->default_value(1),
-            "number of threads to use (default 1)")
-        ("batch_size,z",bpo::value<size_t>()->default_value(250000),
-            "multithreading batch size (default 250000)")
-        ("bad_values,B",bpo::value<size_t>()->default_value(10),
-            "bad value limit for terminating render (default 10)")
-        ("scaler,m",bpo::value<std::string>()->default_value("log"),
-            "scaling function for image render (bin,lin,log) (default log)");
-    bpo::variables_map args;
-    bpo::store(bpo::command_line_parser(argc,argv).options(options).run(),args);
-    if (args.count("help") || args.empty())
+    typedef tkoz::flame::vars<num_t,rand_t> vars_t;
+    const tkoz::flame::Flame<num_t,rand_t>& flame = renderer.getFlame();
+    const std::vector<tkoz::flame::XFormProfile>& profile =
+        renderer.getProfile();
+    auto per_call = [](u64 ticks, u64 calls)
+    { return calls ? nlohmann::json((double)ticks/calls) : nlohmann::json(); };
+    nlohmann::json ret = nlohmann::json::object();
+    ret["interval"] = tkoz::flame::profile_interval;
+    ret["xforms"] = nlohmann::json::array();
+    for (size_t i = 0; i < profile.size(); ++i)
     {
-        std::cerr << options;
-        return 1;
+        const tkoz::flame::XFormProfile& p = profile[i];
+        bool is_final = i == flame.getXForms().size();
+        const tkoz::flame::XForm<num_t,rand_t>& xf = is_final
+            ? flame.getFinalXForm() : flame.getXForms()[i];
+        nlohmann::json x = nlohmann::json::object();
+        if (!is_final)
+        {
+            size_t iterated = renderer.getXFormDistribution()[i];
+            x["iterated"] = iterated;
+            x["plotted"] = p.plotted;
+            x["plot_rate"] = iterated ? (double)p.plotted/iterated : 0.0;
+            x["bad_values"] = p.bad_values;
+        }
+        x["final"] = is_final;
+        x["timed"] = p.timed;
+        x["ticks_per_call"] = per_call(p.ticks,p.timed);
+        x["variations"] = nlohmann::json::array();
+        for (size_t j = 0; j < xf.getVariations().size(); ++j)
+        {
+            nlohmann::json v = nlohmann::json::object();
+            v["name"] = vars_t::data[xf.getVariations()[j].id].name;
+            v["ticks_per_call"] = per_call(p.var_ticks[j],p.var_timed);
+            x["variations"].push_back(v);
+        }
+        ret["xforms"].push_back(x);
     }
-    if (!args.count("flame")) // required argument
+    return ret;
+}
+
+// render (or serve) with the number, histogram and rng types chosen by
+// the command line
+template <typename num_t, typename hist_t, typename rand_t>
+int render_main(const bpo::variables_map& args)
+{
+    std::string arg_batch = args["batch"].as<std::string>();
+    std::string arg_server = args["server"].as<std::string>();
+    std::string arg_compile = args["compile"].as<std::string>();
+    std::string arg_precision = args["precision"].as<std::string>();
+    size_t arg_hist_bits = args["hist_bits"].as<size_t>();
+    std::string arg_rng = args["rng"].as<std::string>();
+    bool flame_arg_needed = arg_batch == "" && arg_server == "";
+    if (!args.count("flame") && flame_arg_needed) // required argument
     {
         std::cerr << "error: flame JSON not specified" << std::endl;
         return 1;
     }
-    if (!args.count("output")) // required argument
+    if (!args.count("output") && flame_arg_needed
+        && arg_compile == "") // required argument
     {
         std::cerr << "error: output file not specified" << std::endl;
         return 1;
     }
     // cmdline values
-    std::string arg_flame = args["flame"].as<std::string>();
+    std::string arg_flame = args.count("flame")
+        ? args["flame"].as<std::string>() : "";
     std::string arg_input = args["input"].as<std::string>();
     size_t arg_samples = args["samples"].as<size_t>();
-    std::string arg_output = args["output"].as<std::string>();
+    std::string arg_output = args.count("output")
+        ? args["output"].as<std::string>() : "";
     std::string arg_type = args["type"].as<std::string>();
     size_t arg_img_bits = args["img_bits"].as<size_t>();
     size_t arg_threads = args["threads"].as<size_t>();
     size_t arg_batch_size = args["batch_size"].as<size_t>();
     size_t arg_bad_values = args["bad_values"].as<size_t>();
     std::string arg_scaler = args["scaler"].as<std::string>();
+    size_t arg_png_level = args["png_level"].as<size_t>();
+    std::string arg_png_filter = args["png_filter"].as<std::string>();
+    size_t arg_oversample = args["oversample"].as<size_t>();
+    std::string arg_filter = args["filter"].as<std::string>();
+    float arg_de_radius = args["de_radius"].as<float>();
+    float arg_de_min_radius = args["de_min_radius"].as<float>();
+    float arg_de_curve = args["de_curve"].as<float>();
+    bool arg_color = args["color"].as<bool>();
+    std::string arg_color_mode = args["color_mode"].as<std::string>();
+    size_t arg_check_interval = args["check_interval"].as<size_t>();
+    double arg_min_plot_ratio = args["min_plot_ratio"].as<double>();
+    double arg_converge = args["converge"].as<double>();
+    double arg_max_bad_rate = args["max_bad_rate"].as<double>();
+    double arg_shrink = args["shrink"].as<double>();
+    size_t arg_frame = args["frame"].as<size_t>();
+    double arg_frame_quantile = args["frame_quantile"].as<double>();
+    std::string arg_frame_json = args["frame_json"].as<std::string>();
+    size_t arg_frames = args["frames"].as<size_t>();
+    double arg_shutter = args["shutter"].as<double>();
+    size_t arg_blur_buckets = args["blur_buckets"].as<size_t>();
+    size_t arg_batch_small = args["batch_small"].as<size_t>();
+    std::string arg_cache = args["cache"].as<std::string>();
+    std::string arg_preview = args["preview"].as<std::string>();
+    double arg_preview_interval = args["preview_interval"].as<double>();
+    size_t arg_preview_size = args["preview_size"].as<size_t>();
+    size_t arg_mixed = args["mixed"].as<size_t>();
+    size_t arg_chains = args["chains"].as<size_t>();
+    std::string arg_kernel = args["kernel"].as<std::string>();
+    std::string arg_kernel_include =
+        args["kernel_include"].as<std::string>();
+    std::string arg_profile_json = args["profile_json"].as<std::string>();
     //std::string arg_precision = args["precision"].as<std::string>();
     //size_t arg_hist_bits = args["hist_bits"].as<size_t>();
     // check args
     if (arg_type != "" && arg_type != "png" && arg_type != "pgm"
-        && arg_type != "buf")
+        && arg_type != "ppm" && arg_type != "buf")
     {
         std::cerr << "error: invalid output type" << std::endl;
         return 1;
@@ -109,6 +234,11 @@ int main(int argc, char **argv)
         std::cerr << "error: must use between 1 and 128 threads" << std::endl;
         return 1;
     }
+    if (arg_chains < 1 || arg_chains > tkoz::flame::max_chains)
+    {
+        std::cerr << "error: chains must be 1-8" << std::endl;
+        return 1;
+    }
     if (arg_batch_size < (1<<12) || arg_batch_size > (1<<30))
     {
         std::cerr << "error: batch size < 2^12 or > 2^30" << std::endl;
@@ -124,12 +254,54 @@ int main(int argc, char **argv)
         std::cerr << "error: scaler must be bin/lin/log" << std::endl;
         return 1;
     }
-    if (arg_type == "") // find type from extension
+    if (arg_png_level > 9)
+    {
+        std::cerr << "error: png compression level must be 0-9" << std::endl;
+        return 1;
+    }
+    int png_filter = png_filter_flags(arg_png_filter);
+    if (png_filter < 0)
+    {
+        std::cerr << "error: invalid png filter" << std::endl;
+        return 1;
+    }
+    if (arg_oversample < 1 || arg_oversample > tkoz::flame::max_oversample)
+    {
+        std::cerr << "error: oversample must be 1-16" << std::endl;
+        return 1;
+    }
+    if (arg_filter != "box" && arg_filter != "gaussian")
+    {
+        std::cerr << "error: filter must be box/gaussian" << std::endl;
+        return 1;
+    }
+    if (arg_de_radius < 0.0 || arg_de_radius > tkoz::flame::max_de_radius)
+    {
+        std::cerr << "error: density estimation radius must be 0-32"
+            << std::endl;
+        return 1;
+    }
+    if (arg_de_min_radius < 0.0 || arg_de_min_radius > arg_de_radius)
+    {
+        std::cerr << "error: density estimation min radius must be"
+            " between 0 and the max radius" << std::endl;
+        return 1;
+    }
+    if (arg_de_curve <= 0.0)
+    {
+        std::cerr << "error: density estimation curve must be positive"
+            << std::endl;
+        return 1;
+    }
+    // find type from extension
+    if (arg_type == "" && flame_arg_needed && arg_compile == "")
     {
         if (string_ends_with(arg_output,".png"))
             arg_type = "png";
         else if (string_ends_with(arg_output,".pgm"))
             arg_type = "pgm";
+        else if (string_ends_with(arg_output,".ppm"))
+            arg_type = "ppm";
         else if (string_ends_with(arg_output,".buf"))
             arg_type = "buf";
         else
@@ -138,6 +310,135 @@ int main(int argc, char **argv)
             return 1;
         }
     }
+    if (arg_color_mode != "index" && arg_color_mode != "rgb")
+    {
+        std::cerr << "error: color mode must be index/rgb" << std::endl;
+        return 1;
+    }
+    if (arg_check_interval < 1)
+    {
+        std::cerr << "error: check interval must be positive" << std::endl;
+        return 1;
+    }
+    if (arg_min_plot_ratio < 0.0 || arg_min_plot_ratio > 1.0)
+    {
+        std::cerr << "error: min plot ratio must be 0-1" << std::endl;
+        return 1;
+    }
+    if (arg_max_bad_rate < 0.0 || arg_max_bad_rate > 1.0)
+    {
+        std::cerr << "error: max bad rate must be 0-1" << std::endl;
+        return 1;
+    }
+    if (arg_shrink < 0.0 || arg_shrink >= 1.0)
+    {
+        std::cerr << "error: shrink must be in [0,1)" << std::endl;
+        return 1;
+    }
+    if (arg_converge < 0.0)
+    {
+        std::cerr << "error: convergence threshold must be nonnegative"
+            << std::endl;
+        return 1;
+    }
+    if (arg_frame_quantile < 0.0 || arg_frame_quantile >= 0.5)
+    {
+        std::cerr << "error: frame quantile must be in [0,0.5)" << std::endl;
+        return 1;
+    }
+    if (arg_frame_json != "" && !arg_frame)
+    {
+        std::cerr << "error: frame JSON requires frame samples" << std::endl;
+        return 1;
+    }
+    if (arg_preview_interval <= 0.0)
+    {
+        std::cerr << "error: preview interval must be positive" << std::endl;
+        return 1;
+    }
+    if (arg_preview_size < 16 || arg_preview_size > 4096)
+    {
+        std::cerr << "error: preview size must be 16-4096" << std::endl;
+        return 1;
+    }
+    size_t output_ext = arg_output.rfind('.');
+    if (arg_frames && (arg_type == "buf" || arg_input != "" || arg_frame
+        || arg_preview != "" || output_ext == std::string::npos
+        || arg_output.find('/',output_ext) != std::string::npos))
+    {
+        std::cerr << "error: animation requires image output to a file name"
+            " with an extension and no input/frame/preview" << std::endl;
+        return 1;
+    }
+    if (arg_shutter < 0.0 || (arg_shutter > 0.0 && !arg_frames))
+    {
+        std::cerr << "error: shutter must be nonnegative and requires frames"
+            << std::endl;
+        return 1;
+    }
+    if (arg_blur_buckets < 1
+        || arg_blur_buckets > tkoz::flame::max_blur_buckets)
+    {
+        std::cerr << "error: blur buckets must be 1-256" << std::endl;
+        return 1;
+    }
+    if (!flame_arg_needed && (arg_flame != "" || arg_output != ""
+        || arg_input != "" || arg_frame || arg_frames || arg_preview != ""
+        || arg_compile != "" || (arg_batch != "" && arg_server != "")))
+    {
+        std::cerr << "error: batch/server cannot be used with flame/output/"
+            "input/frame/frames/preview/compile or each other" << std::endl;
+        return 1;
+    }
+    if (arg_compile != "" && (arg_frames || arg_flame == "-"))
+    {
+        std::cerr << "error: compile requires a flame file and no frames"
+            << std::endl;
+        return 1;
+    }
+    if (arg_cache != "" && (!flame_arg_needed || arg_input != ""
+        || arg_frame || arg_frames))
+    {
+        std::cerr << "error: cache cannot be used with batch/server/input/"
+            "frame/frames" << std::endl;
+        return 1;
+    }
+    if (arg_mixed > tkoz::flame::max_mixed_iters || (arg_mixed
+        && (arg_precision != "single" || !flame_arg_needed || arg_frames
+        || arg_cache != "")))
+    {
+        std::cerr << "error: mixed must be 0-64 and requires single precision"
+            " and no batch/server/frames/cache" << std::endl;
+        return 1;
+    }
+    if (arg_kernel != "" && (!flame_arg_needed || arg_frames))
+    {
+        std::cerr << "error: kernel cannot be used with batch/server/frames"
+            << std::endl;
+        return 1;
+    }
+    if (arg_kernel_include != "" && arg_kernel == "")
+    {
+        std::cerr << "error: kernel_include requires kernel" << std::endl;
+        return 1;
+    }
+    if (arg_profile_json != "" && (!tkoz::flame::profile_enabled
+        || !flame_arg_needed || arg_frames))
+    {
+        std::cerr << "error: profile_json requires building with"
+            " -DFLAME_PROFILE and no batch/server/frames" << std::endl;
+        return 1;
+    }
+    if (arg_type == "pgm" && arg_color)
+    {
+        std::cerr << "error: use ppm for color output" << std::endl;
+        return 1;
+    }
+    if (arg_type == "ppm" && !arg_color)
+    {
+        std::cerr << "error: ppm output requires color" << std::endl;
+        return 1;
+    }
     // print options
     std::cerr << "ffbuf" << std::endl;
     std::cerr << "--flame: " << arg_flame << std::endl;
@@ -149,30 +450,391 @@ int main(int argc, char **argv)
     std::cerr << "--threads: " << arg_threads << std::endl;
     std::cerr << "--batch_size: " << arg_batch_size << std::endl;
     std::cerr << "--bad_values: " << arg_bad_values << std::endl;
+    std::cerr << "--png_level: " << arg_png_level << std::endl;
+    std::cerr << "--png_filter: " << arg_png_filter << std::endl;
+    std::cerr << "--oversample: " << arg_oversample << std::endl;
+    std::cerr << "--filter: " << arg_filter << std::endl;
+    std::cerr << "--de_radius: " << arg_de_radius << std::endl;
+    std::cerr << "--de_min_radius: " << arg_de_min_radius << std::endl;
+    std::cerr << "--de_curve: " << arg_de_curve << std::endl;
+    std::cerr << "--color: " << arg_color << std::endl;
+    std::cerr << "--color_mode: " << arg_color_mode << std::endl;
+    std::cerr << "--check_interval: " << arg_check_interval << std::endl;
+    std::cerr << "--min_plot_ratio: " << arg_min_plot_ratio << std::endl;
+    std::cerr << "--max_bad_rate: " << arg_max_bad_rate << std::endl;
+    std::cerr << "--shrink: " << arg_shrink << std::endl;
+    std::cerr << "--converge: " << arg_converge << std::endl;
+    std::cerr << "--frame: " << arg_frame << std::endl;
+    std::cerr << "--frame_quantile: " << arg_frame_quantile << std::endl;
+    std::cerr << "--frame_json: " << arg_frame_json << std::endl;
+    std::cerr << "--frames: " << arg_frames << std::endl;
+    std::cerr << "--shutter: " << arg_shutter << std::endl;
+    std::cerr << "--blur_buckets: " << arg_blur_buckets << std::endl;
+    std::cerr << "--batch: " << arg_batch << std::endl;
+    std::cerr << "--batch_small: " << arg_batch_small << std::endl;
+    std::cerr << "--server: " << arg_server << std::endl;
+    std::cerr << "--cache: " << arg_cache << std::endl;
+    std::cerr << "--preview: " << arg_preview << std::endl;
+    std::cerr << "--preview_interval: " << arg_preview_interval << std::endl;
+    std::cerr << "--preview_size: " << arg_preview_size << std::endl;
+    std::cerr << "--mixed: " << arg_mixed << std::endl;
+    std::cerr << "--chains: " << arg_chains << std::endl;
+    std::cerr << "--kernel: " << arg_kernel << std::endl;
+    std::cerr << "--kernel_include: " << arg_kernel_include << std::endl;
+    std::cerr << "--profile_json: " << arg_profile_json << std::endl;
+    std::cerr << "--compile: " << arg_compile << std::endl;
+    std::cerr << "--precision: " << arg_precision << std::endl;
+    std::cerr << "--hist_bits: " << arg_hist_bits << std::endl;
+    std::cerr << "--rng: " << arg_rng << std::endl;
     std::cerr << "--" << std::endl;
-    // parse flame file
+    tkoz::flame::color_mode_t color_mode = tkoz::flame::COLOR_NONE;
+    if (arg_color)
+        color_mode = arg_color_mode == "rgb" ? tkoz::flame::COLOR_RGB
+            : tkoz::flame::COLOR_INDEX;
+    std::function<num_t(hist_t)> scale;
+    if (arg_scaler == "binary")
+        scale = [](hist_t n) { return n ? 1.0 : 0.0; };
+    else if (arg_scaler == "linear")
+        scale = [](hist_t n) { return (num_t)n; };
+    else if (arg_scaler == "log")
+        scale = [](hist_t n) { return log(1.0+(num_t)n); };
+    // render image from a histogram, streaming rows to the encoder
+    // type is png, pgm or ppm, threads is for density estimation/filtering
+    auto write_image = [&](auto& renderer, std::ostream& os,
+        const std::string& type, size_t threads)
+    {
+        size_t X = renderer.getFlame().getSizeX();
+        size_t Y = renderer.getFlame().getSizeY();
+        auto write_rows = [&](auto& writer)
+        {
+            auto write8 = [&writer](const u8 *row)
+                { return writer.writeRow(row); };
+            auto write16 = [&writer](const u16 *row)
+                { return writer.writeRow(row); };
+            bool ret;
+            if (arg_color && arg_img_bits == 8)
+                ret = renderer.template renderColorImageRows<u8>(scale,write8,
+                    threads);
+            else if (arg_color)
+                ret = renderer.template renderColorImageRows<u16>(scale,
+                    write16,threads);
+            else if (arg_img_bits == 8)
+                ret = renderer.template renderImageRows<u8>(scale,write8,
+                    threads);
+            else
+                ret = renderer.template renderImageRows<u16>(scale,write16,
+                    threads);
+            return ret && writer.finish();
+        };
+        size_t channels = arg_color ? 3 : 1;
+        if (type == "png")
+        {
+            PngWriter writer(os,X,Y,arg_img_bits,arg_png_level,png_filter,
+                channels);
+            return write_rows(writer);
+        }
+        else // pgm or ppm
+        {
+            PgmWriter writer(os,X,Y,arg_img_bits,channels);
+            return write_rows(writer);
+        }
+    };
+    if (arg_server != "")
+    {
+        tkoz::flame::RenderServer<num_t,hist_t,rand_t> server(arg_threads,
+            [&](tkoz::flame::RendererBasic<num_t,hist_t,rand_t>& r,
+                std::ostream& os, const std::string& type)
+            {
+                if (type != "png" && type != "pgm" && type != "ppm")
+                    return false;
+                if ((type == "ppm") != arg_color)
+                    return false;
+                r.setFilter(arg_filter == "box" ? tkoz::flame::FILTER_BOX
+                    : tkoz::flame::FILTER_GAUSSIAN);
+                r.setDensityEstimation(arg_de_radius,arg_de_min_radius,
+                    arg_de_curve);
+                return write_image(r,os,type,arg_threads);
+            },
+            arg_oversample,color_mode,arg_batch_size,arg_bad_values);
+        server.setChains(arg_chains);
+        if (arg_server == "-")
+        {
+            server.serveStream(0,1);
+            return 0;
+        }
+        std::cerr << "listening on " << arg_server << std::endl;
+        server.serveSocket(arg_server);
+        std::cerr << "error: cannot listen on " << arg_server << std::endl;
+        return 1;
+    }
+    if (arg_batch != "")
+    {
+        std::vector<tkoz::flame::BatchJob> jobs;
+        std::vector<std::string> types;
+        std::ifstream manifest(arg_batch);
+        if (!manifest)
+        {
+            std::cerr << "error: cannot read batch manifest" << std::endl;
+            return 1;
+        }
+        std::string line;
+        size_t failed = 0; // jobs with unreadable flames
+        for (size_t n = 1; std::getline(manifest,line); ++n)
+        {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            try
+            {
+                Json entry(line);
+                tkoz::flame::BatchJob job;
+                job.output = entry["output"].stringValue();
+                std::string flame_path = entry["flame"].stringValue();
+                try
+                {
+                    std::string data = read_text_file(flame_path);
+                    if (tkoz::flame::FlameBinary<num_t,rand_t>::isBinary(data))
+                        job.binary = data;
+                    else
+                        job.flame = Json(data);
+                }
+                catch (std::exception& e)
+                {
+                    std::cerr << "error: " << job.output << ": cannot read "
+                        << flame_path << ": " << e.what() << std::endl;
+                    ++failed;
+                    continue;
+                }
+                Json value;
+                job.samples = entry.valueAt("samples",value)
+                    ? value.intValue() : arg_samples;
+                if (entry.valueAt("size_x",value)
+                        && !(job.size_x = value.intValue()))
+                    throw std::runtime_error("size_x out of bounds");
+                if (entry.valueAt("size_y",value)
+                        && !(job.size_y = value.intValue()))
+                    throw std::runtime_error("size_y out of bounds");
+                std::string type = string_ends_with(job.output,".png") ? "png"
+                    : string_ends_with(job.output,".pgm") ? "pgm"
+                    : string_ends_with(job.output,".ppm") ? "ppm" : "";
+                if (type == "" || (type == "ppm") != arg_color)
+                    throw std::runtime_error("invalid output type");
+                jobs.push_back(job);
+                types.push_back(type);
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << "error: batch line " << n << ": " << e.what()
+                    << std::endl;
+                return 1;
+            }
+        }
+        std::cerr << "batch jobs: " << jobs.size() << std::endl;
+        tkoz::flame::BatchRenderer<num_t,hist_t,rand_t> renderer(arg_threads,
+            arg_oversample,color_mode,arg_batch_small);
+        renderer.setFilter(arg_filter == "box" ? tkoz::flame::FILTER_BOX
+            : tkoz::flame::FILTER_GAUSSIAN);
+        renderer.setChains(arg_chains);
+        renderer.setDensityEstimation(arg_de_radius,arg_de_min_radius,
+            arg_de_curve);
+        std::mutex print_mutex;
+        struct timespec t1,t2;
+        clock_gettime(CLOCK_MONOTONIC,&t1);
+        failed += renderer.render(jobs,arg_batch_size,arg_bad_values,
+            [&](size_t i, tkoz::flame::RendererBasic<num_t,hist_t,rand_t>& r,
+                size_t threads)
+            {
+                std::ofstream ofs(jobs[i].output,
+                    std::ios::out|std::ios::binary);
+                return write_image(r,ofs,types[i],threads) && ofs.good();
+            },
+            [&](size_t i, const std::string& error)
+            {
+                std::lock_guard<std::mutex> lock(print_mutex);
+                if (error.empty())
+                    std::cerr << "done: " << jobs[i].output << std::endl;
+                else
+                    std::cerr << "error: " << jobs[i].output << ": " << error
+                        << std::endl;
+            });
+        clock_gettime(CLOCK_MONOTONIC,&t2);
+        size_t nsecs = 1000000000uLL*(t2.tv_sec-t1.tv_sec)
+            +(t2.tv_nsec-t1.tv_nsec);
+        fprintf(stderr,"time (seconds): %f\n",(float)nsecs/1000000000.0);
+        fprintf(stderr,"failed jobs: %lu\n",failed);
+        return failed ? 1 : 0;
+    }
+    // parse flame file, binary flames are loaded directly (no JSON)
+    bool flame_binary = arg_flame != "-"
+        && tkoz::flame::FlameBinary<num_t,rand_t>::isBinaryFile(arg_flame);
     Json json_flame;
-    if (arg_flame == "-") // input from stdin
-        json_flame = Json(std::cin);
+    if (flame_binary)
+    {
+        if (arg_frames || arg_frame_json != "" || arg_cache != "")
+        {
+            std::cerr << "error: binary flame cannot be used with frames/"
+                "frame_json/cache" << std::endl;
+            return 1;
+        }
+        std::cerr << "flame: binary" << std::endl;
+    }
     else
-        json_flame = Json(read_text_file(arg_flame));
-    std::cerr << "flame json (comments removed): " << json_flame << std::endl;
-    tkoz::flame::RendererBasic<num_t,u32,rand_t> renderer(json_flame);
+    {
+        if (arg_flame == "-") // input from stdin
+            json_flame = Json(std::cin);
+        else
+            json_flame = Json(read_text_file(arg_flame));
+        std::cerr << "flame json (comments removed): " << json_flame
+            << std::endl;
+    }
+    if (arg_frames) // animation, flame JSON has keyframes
+    {
+        tkoz::flame::Animation<num_t,rand_t> animation(json_flame);
+        tkoz::flame::AnimationRenderer<num_t,hist_t,rand_t> renderer(animation,
+            arg_threads,arg_oversample,color_mode);
+        renderer.setFilter(arg_filter == "box" ? tkoz::flame::FILTER_BOX
+            : tkoz::flame::FILTER_GAUSSIAN);
+        renderer.setDensityEstimation(arg_de_radius,arg_de_min_radius,
+            arg_de_curve);
+        renderer.setMotionBlur(arg_shutter,arg_blur_buckets);
+        renderer.setChains(arg_chains);
+        std::cerr << "keyframes: " << animation.getKeyframeCount()
+            << std::endl;
+        // frame number goes before the extension
+        auto frame_name = [&arg_output,output_ext](size_t k)
+        {
+            char num[32];
+            snprintf(num,sizeof(num),"_%05lu",k);
+            return arg_output.substr(0,output_ext) + num
+                + arg_output.substr(output_ext);
+        };
+        struct timespec t1,t2;
+        clock_gettime(CLOCK_MONOTONIC,&t1);
+        bool success = renderer.render(arg_frames,arg_samples,arg_batch_size,
+            arg_bad_values,
+            [&](size_t k, tkoz::flame::RendererBasic<num_t,hist_t,rand_t>& r)
+            {
+                std::ofstream ofs(frame_name(k),
+                    std::ios::out|std::ios::binary);
+                return write_image(r,ofs,arg_type,arg_threads) && ofs.good();
+            },
+            [&](size_t k,
+                const tkoz::flame::RendererBasic<num_t,hist_t,rand_t>& r,
+                tkoz::flame::render_status_t status)
+            {
+                fprintf(stderr,"frame %lu: iterated %lu plotted %lu"
+                    " bad values %lu%s\n",k,r.getSamplesIterated(),
+                    r.getSamplesPlotted(),r.getBadValueCount(),
+                    status == tkoz::flame::RENDER_DONE ? "" : " (stopped)");
+            });
+        clock_gettime(CLOCK_MONOTONIC,&t2);
+        size_t nsecs = 1000000000uLL*(t2.tv_sec-t1.tv_sec)
+            +(t2.tv_nsec-t1.tv_nsec);
+        fprintf(stderr,"time (seconds): %f\n",(float)nsecs/1000000000.0);
+        if (!success)
+        {
+            std::cerr << "error: cannot write image" << std::endl;
+            return 1;
+        }
+        std::cerr << "output done" << std::endl;
+        return 0;
+    }
+    tkoz::flame::Flame<num_t,rand_t> input_flame = flame_binary
+        ? tkoz::flame::FlameBinary<num_t,rand_t>::readFile(arg_flame)
+        : tkoz::flame::Flame<num_t,rand_t>(json_flame);
+    // the flame in double for finding bounds, the binary flame and mixed
+    // precision, so their bounds and coefficients are not rounded to num_t
+    std::unique_ptr<tkoz::flame::Flame<double,rand_t>> precise_flame;
+    if (arg_frame || arg_compile != "" || arg_mixed)
+        precise_flame.reset(new tkoz::flame::Flame<double,rand_t>(flame_binary
+            ? tkoz::flame::FlameBinary<double,rand_t>::readFile(arg_flame)
+            : tkoz::flame::Flame<double,rand_t>(json_flame)));
+    if (arg_frame) // replace bounds with those found by iterating
+    {
+        double xmin,xmax,ymin,ymax;
+        if (!tkoz::flame::findFlameBounds(*precise_flame,arg_frame,
+                xmin,xmax,ymin,ymax,arg_frame_quantile))
+        {
+            std::cerr << "error: unable to find flame bounds" << std::endl;
+            return 1;
+        }
+        precise_flame->setBounds(xmin,xmax,ymin,ymax);
+        input_flame.setBounds(xmin,xmax,ymin,ymax);
+        fprintf(stderr,"frame bounds: x [%le,%le] y [%le,%le]\n",
+            xmin,xmax,ymin,ymax);
+        if (arg_frame_json != "")
+        {
+            json_flame.setValue("xmin",Json(nlohmann::json(xmin)));
+            json_flame.setValue("xmax",Json(nlohmann::json(xmax)));
+            json_flame.setValue("ymin",Json(nlohmann::json(ymin)));
+            json_flame.setValue("ymax",Json(nlohmann::json(ymax)));
+            std::ofstream ofs(arg_frame_json);
+            ofs << json_flame << std::endl;
+            if (!ofs)
+            {
+                std::cerr << "error: cannot write frame JSON" << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (arg_compile != "")
+    {
+        if (!tkoz::flame::FlameBinary<double,rand_t>::writeFile(arg_compile,
+                *precise_flame))
+        {
+            std::cerr << "error: cannot write binary flame" << std::endl;
+            return 1;
+        }
+        std::cerr << "binary flame written to " << arg_compile << std::endl;
+        return 0;
+    }
+    tkoz::flame::RendererBasic<num_t,hist_t,rand_t>
+        renderer(input_flame,nullptr,arg_oversample,color_mode);
+    if (arg_mixed) // flame in double for recomputing plotted points
+        renderer.setMixedPrecision(*precise_flame,arg_mixed);
+    renderer.setFilter(arg_filter == "box" ? tkoz::flame::FILTER_BOX
+        : tkoz::flame::FILTER_GAUSSIAN);
+    renderer.setDensityEstimation(arg_de_radius,arg_de_min_radius,arg_de_curve);
+    renderer.setChains(arg_chains);
+    if (arg_kernel != "")
+    {
+        auto kernel_start = std::chrono::steady_clock::now();
+        tkoz::flame::KernelCompiler<num_t,rand_t> compiler(arg_kernel,
+            arg_kernel_include != "" ? arg_kernel_include
+            : tkoz::flame::KernelCompiler<num_t,rand_t>::defaultIncludeDir());
+        tkoz::flame::IterKernel<num_t,rand_t> kernel;
+        std::string error;
+        if (compiler.compile(renderer.getFlame(),kernel,error))
+        {
+            renderer.setKernel(kernel);
+            fprintf(stderr,"kernel loaded in %f sec\n",
+                std::chrono::duration<double>(std::chrono::steady_clock::now()
+                - kernel_start).count());
+        }
+        else
+            std::cerr << "warn: kernel not used: " << error << std::endl;
+    }
     const tkoz::flame::Flame<num_t,rand_t>& flame = renderer.getFlame();
     std::cerr << "x size: " << flame.getSizeX() << std::endl;
     std::cerr << "y size: " << flame.getSizeY() << std::endl;
+    std::cerr << "histogram x size: " << renderer.getHistogramSizeX()
+        << std::endl;
+    std::cerr << "histogram y size: " << renderer.getHistogramSizeY()
+        << std::endl;
     num_t xdiff = flame.getXMax() - flame.getXMin();
     num_t ydiff = flame.getYMax() - flame.getYMin();
     fprintf(stderr,"rect ratio (render bounds): %f\n",(float)ydiff/xdiff);
     fprintf(stderr,"size ratio (buffer): %f\n",
         (float)flame.getSizeY()/flame.getSizeX());
-    u32 *buf = renderer.getHistogram(); // buffer to overwrite
+    hist_t *buf = renderer.getHistogram(); // buffer to overwrite
+    char *color_buf = (char*)renderer.getColorBuffer(); // follows histogram
+    size_t color_bytes = renderer.getColorBufferSizeBytes();
     // load buffer if specified
     if (arg_input != "")
     {
         if (arg_input == "-") // input from stdin
         {
-            if (!std::cin.read((char*)buf,renderer.getHistogramSizeBytes()))
+            if (!std::cin.read((char*)buf,renderer.getHistogramSizeBytes())
+                || !std::cin.read(color_buf,color_bytes))
             {
                 std::cerr << "error: unable to read (enough) buffer bytes"
                     << std::endl;
@@ -184,7 +846,8 @@ int main(int argc, char **argv)
         else
         {
             std::ifstream ifs(arg_input,std::ios::in|std::ios::binary);
-            if (!ifs.read((char*)buf,renderer.getHistogramSizeBytes()))
+            if (!ifs.read((char*)buf,renderer.getHistogramSizeBytes())
+                || !ifs.read(color_buf,color_bytes))
             {
                 std::cerr << "error: unable to read (enough) buffer bytes"
                     << std::endl;
@@ -195,6 +858,20 @@ int main(int argc, char **argv)
             ifs.close();
         }
     }
+    // start from a cached histogram of the same flame and settings, so only
+    // the remaining samples are rendered
+    tkoz::flame::HistogramCache cache(arg_cache);
+    std::string cache_key;
+    size_t cached_samples = 0;
+    if (arg_cache != "")
+    {
+        cache_key = tkoz::flame::HistogramCache::renderKey(json_flame,
+            arg_oversample,color_mode,sizeof(num_t),sizeof(hist_t));
+        if (cache.load(cache_key,(char*)buf,renderer.getHistogramSizeBytes(),
+                color_buf,color_bytes,arg_samples,cached_samples))
+            arg_samples -= cached_samples;
+        fprintf(stderr,"cached samples: %lu\n",cached_samples);
+    }
     size_t buffer_sum_initial = 0;
     for (size_t i = 0; i < renderer.getHistogramSize(); ++i)
         buffer_sum_initial += buf[i];
@@ -207,7 +884,40 @@ int main(int argc, char **argv)
         clock_gettime(CLOCK_MONOTONIC,&t1);
         size_t prev_percent = 0;
         //renderer.renderBuffer(arg_samples,rng);
-        renderer.renderBufferParallel(arg_samples,arg_threads,
+        tkoz::flame::RenderMonitor monitor(arg_check_interval,
+            arg_min_plot_ratio,arg_converge,nullptr,arg_max_bad_rate,
+            arg_shrink);
+        // preview images are made from histogram snapshots on their own
+        // thread so the render threads never wait for them
+        std::mutex preview_mutex;
+        std::condition_variable preview_cv;
+        bool render_done = false;
+        std::thread preview_thread;
+        if (arg_preview != "")
+            preview_thread = std::thread([&]()
+            {
+                auto interval = std::chrono::duration<double>(
+                    arg_preview_interval);
+                std::unique_lock<std::mutex> lock(preview_mutex);
+                while (!preview_cv.wait_for(lock,interval,
+                        [&render_done]() { return render_done; }))
+                {
+                    lock.unlock();
+                    size_t sx,sy;
+                    std::vector<float> snapshot =
+                        renderer.logSnapshot(arg_preview_size,sx,sy);
+                    std::vector<u8> img(sx*sy);
+                    for (size_t r = 0; r < sy; ++r) // flip rows
+                        for (size_t c = 0; c < sx; ++c)
+                            img[sx*r+c] = (u8)(255.0f*snapshot[sx*(sy-1-r)+c]);
+                    if (!write_image_file(arg_preview,sx,sy,img.data()))
+                        std::cerr << std::endl << "warn: cannot write preview"
+                            << std::endl;
+                    lock.lock();
+                }
+            });
+        tkoz::flame::render_status_t status =
+            renderer.renderBufferParallel(arg_samples,arg_threads,
             arg_batch_size,arg_bad_values,
             [&prev_percent,&t1,&t2](float p)
             {
@@ -227,17 +937,45 @@ int main(int argc, char **argv)
             {
                 std::cerr << "starting thread " << index << " ("
                     << thread.get_id() << ')' << std::endl;
-            });
-        std::cerr << '\r' << "rendering... 100%" << std::endl;
+            },
+            monitor);
+        if (preview_thread.joinable())
+        {
+            preview_mutex.lock();
+            render_done = true;
+            preview_mutex.unlock();
+            preview_cv.notify_one();
+            preview_thread.join();
+        }
+        if (status == tkoz::flame::RENDER_DONE
+                || status == tkoz::flame::RENDER_SHRUNK)
+            std::cerr << '\r' << "rendering... 100%" << std::endl;
+        else
+            std::cerr << std::endl;
         clock_gettime(CLOCK_MONOTONIC,&t2);
         size_t nsecs = 1000000000uLL*(t2.tv_sec-t1.tv_sec)
             +(t2.tv_nsec-t1.tv_nsec);
         float secs = (float)nsecs/1000000000.0;
-        std::cerr << "render done" << std::endl;
+        std::cerr << "render done";
+        if (status == tkoz::flame::RENDER_BAD_VALUES)
+            std::cerr << " (stopped: bad value limit)";
+        else if (status == tkoz::flame::RENDER_LOW_PLOT_RATIO)
+            std::cerr << " (stopped: plotted/iterated below minimum)";
+        else if (status == tkoz::flame::RENDER_CONVERGED)
+            std::cerr << " (stopped: converged)";
+        else if (status == tkoz::flame::RENDER_CANCELLED)
+            std::cerr << " (stopped: cancelled)";
+        else if (status == tkoz::flame::RENDER_BAD_VALUE_RATE)
+            std::cerr << " (stopped: bad values/iterated above maximum)";
+        else if (status == tkoz::flame::RENDER_SHRUNK)
+            std::cerr << " (samples reduced: plot ratio or bad value rate)";
+        std::cerr << std::endl;
         fprintf(stderr,"time (seconds): %f\n",secs);
         fprintf(stderr,"samples iterated: %lu\n",renderer.getSamplesIterated());
         fprintf(stderr,"samples plotted: %lu\n",renderer.getSamplesPlotted());
-        fprintf(stderr,"samples/sec: %lf\n",renderer.getSamplesIterated()/secs);
+        fprintf(stderr,"samples/sec (%s %lu %s): %lf\n",
+            arg_precision.c_str(),arg_hist_bits,arg_rng.c_str(),
+            renderer.getSamplesIterated()/secs);
         double ratio = (double)renderer.getSamplesPlotted()
             /renderer.getSamplesIterated();
         fprintf(stderr,"plotted/iterated: %lf%%\n",100.0*ratio);
@@ -251,15 +989,56 @@ int main(int argc, char **argv)
         fprintf(stderr,"y max: %le\n",renderer.getYMax());
         fprintf(stderr,"bad values: %lu\n",renderer.getBadValueCount());
         std::cerr << "bad value xforms:";
-        for (size_t i = 0; i < renderer.getBadValueCount(); ++i)
-            std::cerr << " " << renderer.getBadValueXForms()[i];
+        for (u32 xf : renderer.getBadValueXForms())
+            std::cerr << " " << xf;
         std::cerr << std::endl;
         std::cerr << "bad value points:";
         for (auto p : renderer.getBadValuePoints())
             fprintf(stderr," (%le,%le)",p.x,p.y);
         std::cerr << std::endl;
-        u32 sample_min = -1;
-        u32 sample_max = 0;
+        if (tkoz::flame::profile_enabled)
+        {
+            nlohmann::json profile = profile_json(renderer);
+            auto ticks = [](const nlohmann::json& t)
+            {
+                char buf[32] = "n/a";
+                if (!t.is_null())
+                    snprintf(buf,sizeof(buf),"%.1lf",t.get<double>());
+                return std::string(buf);
+            };
+            fprintf(stderr,"profile (1 in %u iterations timed):\n",
+                tkoz::flame::profile_interval);
+            for (size_t i = 0; i < profile["xforms"].size(); ++i)
+            {
+                const nlohmann::json& x = profile["xforms"][i];
+                if (x["final"].get<bool>())
+                    fprintf(stderr,"final xform: %s ticks/call\n",
+                        ticks(x["ticks_per_call"]).c_str());
+                else
+                    fprintf(stderr,"xform %lu: %s ticks/call, plotted/"
+                        "iterated %.2lf%%, bad values %lu\n",i,
+                        ticks(x["ticks_per_call"]).c_str(),
+                        100.0*x["plot_rate"].get<double>(),
+                        x["bad_values"].get<size_t>());
+                for (const nlohmann::json& v : x["variations"])
+                    fprintf(stderr,"    %s: %s ticks/call\n",
+                        v["name"].get<std::string>().c_str(),
+                        ticks(v["ticks_per_call"]).c_str());
+            }
+            if (arg_profile_json != "")
+            {
+                std::ofstream ofs(arg_profile_json);
+                ofs << profile << std::endl;
+                if (!ofs)
+                {
+                    std::cerr << "error: cannot write profile JSON"
+                        << std::endl;
+                    return 1;
+                }
+            }
+        }
+        hist_t sample_min = -1;
+        hist_t sample_max = 0;
         size_t buffer_sum = 0;
         for (size_t i = 0; i < renderer.getHistogramSize(); ++i)
         {
@@ -267,8 +1046,8 @@ int main(int argc, char **argv)
             sample_max = std::max(sample_max,buf[i]);
             buffer_sum += buf[i];
         }
-        fprintf(stderr,"sample min: %u\n",sample_min);
-        fprintf(stderr,"sample max: %u\n",sample_max);
+        fprintf(stderr,"sample min: %lu\n",(size_t)sample_min);
+        fprintf(stderr,"sample max: %lu\n",(size_t)sample_max);
         fprintf(stderr,"buffer sum: %lu\n",buffer_sum);
         size_t missed_samples = renderer.getSamplesPlotted()
             - (buffer_sum - buffer_sum_initial);
@@ -276,12 +1055,21 @@ int main(int argc, char **argv)
     }
     else
         std::cerr << "skipping render (0 samples)" << std::endl;
+    // keep the cache entry with the most samples
+    size_t total_samples = cached_samples + renderer.getSamplesIterated();
+    if (arg_cache != "" && total_samples > cache.cachedSamples(cache_key))
+    {
+        if (!cache.store(cache_key,(char*)buf,renderer.getHistogramSizeBytes(),
+                color_buf,color_bytes,total_samples))
+            std::cerr << "warn: cannot write cache" << std::endl;
+    }
     std::cerr << "writing " << arg_output << std::endl;
     if (arg_type == "buf")
     {
         if (arg_output == "-")
         {
             std::cout.write((char*)buf,renderer.getHistogramSizeBytes());
+            std::cout.write(color_buf,color_bytes);
             if (!std::cout)
             {
                 std::cerr << "error: cannot write to stdout" << std::endl;
@@ -292,6 +1080,7 @@ int main(int argc, char **argv)
         {
             std::ofstream ofs(arg_output,std::ios::out|std::ios::binary);
             ofs.write((char*)buf,renderer.getHistogramSizeBytes());
+            ofs.write(color_buf,color_bytes);
             if (!ofs)
             {
                 std::cerr << "error: cannot write output file" << std::endl;
@@ -305,35 +1094,7 @@ int main(int argc, char **argv)
     if (arg_output != "-")
         ofs.open(arg_output,std::ios::out|std::ios::binary);
     std::ostream& os = arg_output != "-" ? ofs : std::cout;
-    u8 *img8 = nullptr;
-    u16 *img16 = nullptr;
-    size_t X = renderer.getFlame().getSizeX();
-    size_t Y = renderer.getFlame().getSizeY();
-    std::function<num_t(u32)> scale;
-    if (arg_scaler == "binary")
-        scale = [](u32 n) { return n ? 1.0 : 0.0; };
-    else if (arg_scaler == "linear")
-        scale = [](u32 n) { return (num_t)n; };
-    else if (arg_scaler == "log")
-        scale = [](u32 n) { return log(1.0+(num_t)n); };
-    bool success;
-    if (arg_img_bits == 8)
-    {
-        img8 = renderer.renderImage<u8>(scale);
-        if (arg_type == "pgm")
-            success = write_pgm(os,X,Y,img8);
-        else // png
-            success = write_png(os,X,Y,img8);
-    }
-    else
-    {
-        img16 = renderer.renderImage<u16>(scale);
-        if (arg_type == "pgm")
-            success = write_pgm(os,X,Y,img16);
-        else // png
-            success = write_png(os,X,Y,img16);
-    }
-    if (!success)
+    if (!write_image(renderer,os,arg_type,arg_threads))
     {
         std::cerr << "error: cannot write image" << std::endl;
         return 1;
@@ -342,9 +1103,197 @@ int main(int argc, char **argv)
     // clean up and exit
     if (arg_output != "-")
         ofs.close();
-    if (img8)
-        delete[] img8;
-    if (img16)
-        delete[] img16;
     return 0;
 }
+
+// instantiate render_main for each rng
+template <typename num_t, typename hist_t>
+int render_rng(const bpo::variables_map& args, const std::string& rng)
+{
+    if (rng == "java")
+        return render_main<num_t,hist_t,JavaRandom>(args);
+    else if (rng == "isaac64")
+        return render_main<num_t,hist_t,Isaac<u64,4>>(args);
+    else
+        return render_main<num_t,hist_t,Isaac<u32,4>>(args);
+}
+
+// samples/sec rendering the flame (from scratch) with the given types
+template <typename num_t, typename hist_t, typename rand_t>
+double bench_types(const bpo::variables_map& args)
+{
+    std::string arg_flame = args["flame"].as<std::string>();
+    tkoz::flame::Flame<num_t,rand_t> flame =
+        tkoz::flame::FlameBinary<num_t,rand_t>::isBinaryFile(arg_flame)
+        ? tkoz::flame::FlameBinary<num_t,rand_t>::readFile(arg_flame)
+        : tkoz::flame::Flame<num_t,rand_t>(Json(read_text_file(arg_flame)));
+    tkoz::flame::RendererBasic<num_t,hist_t,rand_t> renderer(flame,nullptr,
+        args["oversample"].as<size_t>());
+    renderer.setChains(args["chains"].as<size_t>());
+    size_t t1 = clock_nanotime();
+    renderer.renderBufferParallel(args["samples"].as<size_t>(),
+        args["threads"].as<size_t>(),args["batch_size"].as<size_t>(),
+        args["bad_values"].as<size_t>());
+    size_t t2 = clock_nanotime();
+    return renderer.getSamplesIterated()/((t2-t1)/1000000000.0);
+}
+
+// print bench_types for each rng
+template <typename num_t, typename hist_t>
+void bench_rngs(const char *precision, size_t hist_bits,
+    const bpo::variables_map& args)
+{
+    fprintf(stderr,"%s %lu java: %lf samples/sec\n",precision,hist_bits,
+        bench_types<num_t,hist_t,JavaRandom>(args));
+    fprintf(stderr,"%s %lu isaac32: %lf samples/sec\n",precision,hist_bits,
+        bench_types<num_t,hist_t,Isaac<u32,4>>(args));
+    fprintf(stderr,"%s %lu isaac64: %lf samples/sec\n",precision,hist_bits,
+        bench_types<num_t,hist_t,Isaac<u64,4>>(args));
+}
+
+int main(int argc, char **argv)
+{
+    bpo::options_description options("ffgray: usage");
+    options.add_options()
+        ("help,h","show this message")
+        ("flame,f",bpo::value<std::string>(),
+            "flame JSON or binary file (required unless batch/server)")
+        ("output,o",bpo::value<std::string>(),
+            "output file (required unless batch/server/compile)")
+        ("input,i",bpo::value<std::string>()->default_value(""),
+            "buffer (default none, render new buffer)")
+        ("samples,s",bpo::value<size_t>()->default_value(0),
+            "samples to render (default 0)")
+        ("type,t",bpo::value<std::string>()->default_value(""),
+            "output type (png,pgm,ppm,buf) (default use file extension)")
+        ("img_bits,b",bpo::value<size_t>()->default_value(8),
+            "bit depth for png or pgm output (8 or 16) (default 8)")
+        ("threads,T",bpo::value<size_t>()->default_value(1),
+            "number of threads to use (default 1)")
+        ("batch_size,z",bpo::value<size_t>()->default_value(250000),
+            "multithreading batch size (default 250000)")
+        ("bad_values,B",bpo::value<size_t>()->default_value(10),
+            "bad value limit for terminating render (default 10)")
+        ("scaler,m",bpo::value<std::string>()->default_value("log"),
+            "scaling function for image render (bin,lin,log) (default log)")
+        ("png_level,L",bpo::value<size_t>()->default_value(6),
+            "png compression level (0-9) (default 6)")
+        ("png_filter,F",bpo::value<std::string>()->default_value("all"),
+            "png filter (none,sub,up,avg,paeth,all) (default all)")
+        ("oversample,S",bpo::value<size_t>()->default_value(1),
+            "histogram subpixels per image pixel (1-16) (default 1)")
+        ("filter,k",bpo::value<std::string>()->default_value("gaussian"),
+            "downsampling filter (box,gaussian) (default gaussian)")
+        ("de_radius,d",bpo::value<float>()->default_value(0.0),
+            "density estimation max kernel radius (default 0, disabled)")
+        ("de_min_radius",bpo::value<float>()->default_value(0.0),
+            "density estimation min kernel radius (default 0)")
+        ("de_curve",bpo::value<float>()->default_value(0.4),
+            "density estimation kernel radius curve (default 0.4)")
+        ("color,c",bpo::bool_switch()->default_value(false),
+            "render color using the flame palette (buffer includes colors)")
+        ("color_mode,C",bpo::value<std::string>()->default_value("index"),
+            "color accumulation (index,rgb) (default index)")
+        ("check_interval",bpo::value<size_t>()->default_value(1 << 24),
+            "samples between early termination checks (default 2^24)")
+        ("min_plot_ratio",bpo::value<double>()->default_value(0.0),
+            "stop if plotted/iterated is below (default 0, disabled)")
+        ("converge",bpo::value<double>()->default_value(0.0),
+            "stop if relative image change per check is below (default 0)")
+        ("max_bad_rate",bpo::value<double>()->default_value(0.0),
+            "stop if bad values/iterated is above (default 0, disabled)")
+        ("shrink",bpo::value<double>()->default_value(0.0),
+            "remaining samples multiplier for failed rate checks (default 0)")
+        ("frame,a",bpo::value<size_t>()->default_value(0),
+            "samples for finding flame bounds before render (default 0, off)")
+        ("frame_quantile",bpo::value<double>()->default_value(0.001),
+            "fraction of outliers ignored per side (default 0.001)")
+        ("frame_json",bpo::value<std::string>()->default_value(""),
+            "write flame JSON with the found bounds to this file")
+        ("frames,n",bpo::value<size_t>()->default_value(0),
+            "render animation frames from keyframes (default 0, off)")
+        ("shutter",bpo::value<double>()->default_value(0.0),
+            "animation motion blur fraction of frame interval (default 0)")
+        ("blur_buckets",bpo::value<size_t>()->default_value(16),
+            "motion blur times per frame (default 16)")
+        ("batch",bpo::value<std::string>()->default_value(""),
+            "JSONL manifest of flames to render (flame,output,samples,size)")
+        ("batch_small",bpo::value<size_t>()->default_value(1 << 22),
+            "batch jobs with fewer samples run concurrently (default 2^22)")
+        ("server",bpo::value<std::string>()->default_value(""),
+            "serve render requests on a UNIX socket path (- for stdio)")
+        ("cache",bpo::value<std::string>()->default_value(""),
+            "directory of cached histograms to reuse and update")
+        ("preview,P",bpo::value<std::string>()->default_value(""),
+            "preview image (png or pgm) updated during render (default none)")
+        ("preview_interval",bpo::value<double>()->default_value(60.0),
+            "seconds between preview images (default 60)")
+        ("preview_size",bpo::value<size_t>()->default_value(256),
+            "max preview width/height (default 256)")
+        ("compile",bpo::value<std::string>()->default_value(""),
+            "write the flame as a binary flame file instead of rendering")
+        ("precision,p",bpo::value<std::string>()->default_value("single"),
+            "calculation precision (single or double) (default single)")
+        ("hist_bits,w",bpo::value<size_t>()->default_value(32),
+            "histogram integer bit size (32 or 64) (default 32)")
+        ("rng,R",bpo::value<std::string>()->default_value("isaac32"),
+            "random number generator (java,isaac32,isaac64) (default isaac32)")
+        ("bench_types",bpo::bool_switch()->default_value(false),
+            "print samples/sec of the flame for every precision/bits/rng")
+        ("mixed",bpo::value<size_t>()->default_value(0),
+            "iterations recomputed in double for plotting (default 0, off)")
+        ("chains",bpo::value<size_t>()->default_value(1),
+            "iteration chains interleaved by each thread (1-8) (default 1)")
+        ("kernel",bpo::value<std::string>()->default_value(""),
+            "directory to cache iteration kernels compiled for the flame")
+        ("kernel_include",bpo::value<std::string>()->default_value(""),
+            "directory with the headers for compiling kernels")
+        ("profile_json",bpo::value<std::string>()->default_value(""),
+            "write the xform profile JSON to this file (-DFLAME_PROFILE)");
+    bpo::variables_map args;
+    bpo::store(bpo::command_line_parser(argc,argv).options(options).run(),args);
+    if (args.count("help") || args.empty())
+    {
+        std::cerr << options;
+        return 1;
+    }
+    std::string arg_precision = args["precision"].as<std::string>();
+    size_t arg_hist_bits = args["hist_bits"].as<size_t>();
+    std::string arg_rng = args["rng"].as<std::string>();
+    if (arg_precision != "single" && arg_precision != "double")
+    {
+        std::cerr << "error: precision must be single/double" << std::endl;
+        return 1;
+    }
+    if (arg_hist_bits != 32 && arg_hist_bits != 64)
+    {
+        std::cerr << "error: histogram bits must be 32/64" << std::endl;
+        return 1;
+    }
+    if (arg_rng != "java" && arg_rng != "isaac32" && arg_rng != "isaac64")
+    {
+        std::cerr << "error: rng must be java/isaac32/isaac64" << std::endl;
+        return 1;
+    }
+    if (args["bench_types"].as<bool>())
+    {
+        if (!args.count("flame") || args["flame"].as<std::string>() == "-"
+            || args["samples"].as<size_t>() == 0)
+        {
+            std::cerr << "error: type benchmark requires a flame file and"
+                " samples" << std::endl;
+            return 1;
+        }
+        bench_rngs<float,u32>("single",32,args);
+        bench_rngs<float,u64>("single",64,args);
+        bench_rngs<double,u32>("double",32,args);
+        bench_rngs<double,u64>("double",64,args);
+        return 0;
+    }
+    if (arg_precision == "double")
+        return arg_hist_bits == 64 ? render_rng<double,u64>(args,arg_rng)
+            : render_rng<double,u32>(args,arg_rng);
+    else
+        return arg_hist_bits == 64 ? render_rng<float,u64>(args,arg_rng)
+            : render_rng<float,u32>(args,arg_rng);
+}
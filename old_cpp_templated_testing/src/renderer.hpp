@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <numeric>
 #include <thread>
 #include <vector>
 
+#include "thread_pool.hpp"
 #include "types.hpp"
 #include "variations.hpp"
 
@@ -29,6 +34,8 @@ template <typename num_t> struct IterState<num_t,JavaRandom>
     // points, p = current point, t = pre affine transformed point
     // v = variation sum point
     Point2D<num_t> p, t, v;
+    // color coordinate in [0,1], palette index for color rendering
+    num_t c;
     // random number generator state
     JavaRandom& rng;
     // current xform
@@ -36,7 +43,7 @@ template <typename num_t> struct IterState<num_t,JavaRandom>
     // information for selecting random xform
     num_t *cw;
     IterState(JavaRandom& rng):
-        p(0.0,0.0),t(0.0,0.0),v(0.0,0.0),rng(rng),xf(nullptr) {}
+        p(0.0,0.0),t(0.0,0.0),v(0.0,0.0),c(0.0),rng(rng),xf(nullptr) {}
     // functions to get random numbers
     inline bool randBool() { return rng.nextBool(); }
     FUNC_ENABLE_IF(num_t,float,float) inline randNum()
@@ -68,11 +75,12 @@ template <typename num_t, typename word_t, size_t rparam>
 struct IterState<num_t,Isaac<word_t,rparam>>
 {
     Point2D<num_t> p, t, v;
+    num_t c;
     Isaac<word_t,rparam>& rng;
     const XForm<num_t,Isaac<word_t,rparam>> *xf;
     num_t *cw;
     IterState(Isaac<word_t,rparam>& rng):
-        p(0.0,0.0),t(0.0,0.0),v(0.0,0.0),rng(rng),xf(nullptr) {}
+        p(0.0,0.0),t(0.0,0.0),v(0.0,0.0),c(0.0),rng(rng),xf(nullptr) {}
     inline bool randBool() { return rng.next() & 1; }
     FUNC_ENABLE_IF2(num_t,float,word_t,u32,float) inline randNum()
     { return (rng.next() >> 8) / (float)(1 << 24); }
@@ -109,23 +117,72 @@ struct IterState<num_t,Isaac<word_t,rparam>>
 
 template <typename num_t, typename rand_t> struct XFormVar
 {
-    // function pointer
-    std::function<void(IterState<num_t,rand_t>&,const num_t*)> func;
+    // function pointer (from the registry entry for id)
+    void (*func)(IterState<num_t,rand_t>&,const num_t*);
     size_t index; // index of first variation parameter in varp (XForm class)
+    var_id_t id; // variation id (index in vars data)
     // parameters are taken in order starting from index
     // the varp vector keeps the parameters compactly in memory
 };
 
+// profile counters of an xform (see profile_enabled), timed iterations
+// alternate between timing the xform and timing each of its variations,
+// ticks include reading the timer once
+struct XFormProfile
+{
+    u64 plotted; // samples plotted after this xform
+    u64 bad_values; // bad values after this xform
+    u64 timed,ticks; // iterations timed and their total ticks
+    u64 var_timed; // iterations with the variations timed
+    std::vector<u64> var_ticks; // total ticks of each variation
+    XFormProfile(size_t vars = 0): plotted(0),bad_values(0),timed(0),
+        ticks(0),var_timed(0),var_ticks(vars) {}
+    void add(const XFormProfile& p)
+    {
+        plotted += p.plotted;
+        bad_values += p.bad_values;
+        timed += p.timed;
+        ticks += p.ticks;
+        var_timed += p.var_timed;
+        for (size_t i = 0; i < var_ticks.size(); ++i)
+            var_ticks[i] += p.var_ticks[i];
+    }
+    void clear()
+    {
+        plotted = bad_values = timed = ticks = var_timed = 0;
+        std::fill(var_ticks.begin(),var_ticks.end(),0);
+    }
+};
+
+// iteration functions compiled for a flame (made by codegen.hpp), iterate
+// selects an xform by the flame weights, applies it and returns its index,
+// apply_final applies the final xform (null if there is none)
+template <typename num_t, typename rand_t> struct IterKernel
+{
+    u32 (*iterate)(IterState<num_t,rand_t>&);
+    void (*apply_final)(IterState<num_t,rand_t>&);
+    std::shared_ptr<void> library; // keeps the shared object loaded
+    IterKernel(): iterate(nullptr),apply_final(nullptr) {}
+};
+
+// precompiled binary flame reader/writer, defined in flame_binary.hpp
+template <typename num_t, typename rand_t> class FlameBinary;
+
 // xform (including final xform)
 template <typename num_t, typename rand_t> class XForm
 {
 private:
+    friend class FlameBinary<num_t,rand_t>;
     num_t weight; // xform probability weight, not applicable for final xform
     std::vector<XFormVar<num_t,rand_t>> vars; // variations
     std::vector<num_t> varp; // variation parameters
     Affine2D<num_t> pre; // pre affine transformation
     Affine2D<num_t> post; // post affine transformation
     bool has_pre,has_post;
+    // color coordinate moves toward color by color_speed each iteration
+    // xforms without a color do not change the current color
+    num_t color,color_speed;
+    bool has_color;
 public:
     XForm(){}
     // construct from JSON data
@@ -158,23 +215,34 @@ public:
         }
         else
             post = Affine2D<num_t>();
+        Json color_json;
+        has_color = input.valueAt("color",color_json);
+        color = has_color ? color_json.floatValue() : 0.0;
+        color_speed = parse_var_param<num_t>(input,"color_speed",0.5);
+        if (color < 0.0 || color > 1.0)
+            throw std::runtime_error("color must be in [0,1]");
+        if (color_speed < 0.0 || color_speed > 1.0)
+            throw std::runtime_error("color_speed must be in [0,1]");
         for (Json varj : input["variations"].arrayValue())
         {
             XFormVar<num_t,rand_t> var;
             std::string name = varj["name"].stringValue();
-            auto fitr = flame::vars<num_t,rand_t>::data.find(name);
-            if (fitr == flame::vars<num_t,rand_t>::data.end())
+            if (!flame::vars<num_t,rand_t>::find(name,var.id))
                 throw std::runtime_error("unknown variation");
-            var.func = fitr->second.func;
+            const VarInfo<num_t,rand_t>& info =
+                flame::vars<num_t,rand_t>::data[var.id];
+            var.func = info.func;
             var.index = varp.size();
             num_t weight = varj["weight"].floatValue();
             if (weight == 0.0)
                 continue; // skip zero weight variations
             vars.push_back(var);
-            if (fitr->second.params) // store other parameters
-                fitr->second.params(*this,varj,weight,varp);
+            if (info.params) // store other parameters
+                info.params(*this,varj,weight,varp);
             else // store just the weight by default
                 varp.push_back(weight);
+            if (varp.size()-var.index != info.param_count)
+                throw std::runtime_error("variation parameter count mismatch");
         }
     }
     // optimize
@@ -189,6 +257,12 @@ public:
     { return vars; }
     inline const std::vector<num_t>& getVariationParams() const
     { return varp; }
+    inline bool hasColor() const { return has_color; }
+    inline num_t getColor() const { return color; }
+    inline num_t getColorSpeed() const { return color_speed; }
+    // new color coordinate after applying this xform
+    inline num_t applyColor(num_t c) const
+    { return has_color ? c + color_speed*(color - c) : c; }
     // iterate a state for the rendering process
     inline void applyIteration(IterState<num_t,rand_t>& state) const
     {
@@ -201,6 +275,21 @@ public:
         //if (has_post)
             state.p = post.apply_to(state.v);
     }
+    // applyIteration adding the timer ticks of each variation to ticks
+    inline void applyIterationTimed(IterState<num_t,rand_t>& state,
+        u64 *ticks) const
+    {
+        state.xf = this;
+        state.t = pre.apply_to(state.p);
+        state.v = Point2D<num_t>(0.0,0.0);
+        for (size_t i = 0; i < vars.size(); ++i)
+        {
+            u64 t = profile_clock();
+            vars[i].func(state,varp.data()+vars[i].index);
+            ticks[i] += profile_clock()-t;
+        }
+        state.p = post.apply_to(state.v);
+    }
 };
 
 // flame fractal
@@ -214,7 +303,26 @@ private:
     std::vector<XForm<num_t,rand_t>> xforms;
     XForm<num_t,rand_t> final_xform;
     bool has_final_xform;
+    std::vector<rgb_t<u8>> palette; // interpolated to palette_size entries
+    bool has_palette;
+    // original index of each xform after optimize reorders them (empty if
+    // they are in the original order)
+    std::vector<size_t> order;
+    friend class FlameBinary<num_t,rand_t>;
     Flame(){}
+    // xforms[i] becomes the current xforms[perm[i]], orig is the original
+    // index of each current xform
+    void permuteXForms(const std::vector<size_t>& perm,
+        const std::vector<size_t>& orig)
+    {
+        std::vector<XForm<num_t,rand_t>> sorted;
+        for (size_t i : perm)
+            sorted.push_back(xforms[i]);
+        xforms.swap(sorted);
+        order.clear();
+        for (size_t i : perm)
+            order.push_back(orig[i]);
+    }
 public:
     // construct from JSON data
     // throws error if something goes wrong
@@ -222,29 +330,9 @@ public:
     {
         // top level entries
         name = input["name"].stringValue();
-        size_x = input["size_x"].intValue();
-        size_y = input["size_y"].intValue();
-        xmin = input["xmin"].floatValue();
-        xmax = input["xmax"].floatValue();
-        ymin = input["ymin"].floatValue();
-        ymax = input["ymax"].floatValue();
-        if (size_x == 0 || size_x > max_dim)
-            throw std::runtime_error("size_x out of bounds");
-        if (size_y == 0 || size_y > max_dim)
-            throw std::runtime_error("size_y out of bounds");
-        num_t M = max_rect<num_t>::value;
-        if (xmin < -M || xmin > M)
-            throw std::runtime_error("xmin out of bounds");
-        if (xmax < -M || xmax > M)
-            throw std::runtime_error("xmax out of bounds");
-        if (ymin < -M || ymax > M)
-            throw std::runtime_error("ymin out of bounds");
-        if (ymax < -M || ymax > M)
-            throw std::runtime_error("ymax out of bounds");
-        if (xmin >= xmax)
-            throw std::runtime_error("xmin >= xmax");
-        if (ymin >= ymax)
-            throw std::runtime_error("ymin >= ymax");
+        setSize(input["size_x"].intValue(),input["size_y"].intValue());
+        setBounds(input["xmin"].floatValue(),input["xmax"].floatValue(),
+            input["ymin"].floatValue(),input["ymax"].floatValue());
         // xforms loop
         for (Json xf : input["xforms"].arrayValue())
         {
@@ -256,15 +344,127 @@ public:
         has_final_xform = input.valueAt("final_xform",xf);
         if (has_final_xform)
             final_xform = XForm<num_t,rand_t>(input["final_xform"],true);
+        // palette is a list of [r,g,b] colors (0-255) spaced evenly over
+        // [0,1] and linearly interpolated
+        Json palette_json;
+        has_palette = input.valueAt("palette",palette_json);
+        if (has_palette)
+        {
+            std::vector<rgb_t<num_t>> colors;
+            for (Json rgb : palette_json.arrayValue())
+            {
+                num_t C[3];
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    C[i] = rgb[i].floatValue();
+                    if (C[i] < 0.0 || C[i] > 255.0)
+                        throw std::runtime_error("palette color out of bounds");
+                }
+                colors.push_back(rgb_t<num_t>(C[0],C[1],C[2]));
+            }
+            if (colors.empty())
+                throw std::runtime_error("palette is empty");
+            for (size_t i = 0; i < palette_size; ++i)
+            {
+                num_t pos = (num_t)i*(colors.size()-1)/(palette_size-1);
+                size_t j = std::min((size_t)pos,colors.size()-1);
+                size_t k = std::min(j+1,colors.size()-1);
+                num_t f = pos - j;
+                palette.push_back(rgb_t<u8>(
+                    (u8)round(colors[j].r + f*(colors[k].r-colors[j].r)),
+                    (u8)round(colors[j].g + f*(colors[k].g-colors[j].g)),
+                    (u8)round(colors[j].b + f*(colors[k].b-colors[j].b))));
+            }
+        }
     }
     void optimize()
     {
-        std::sort(xforms.begin(),xforms.end(),
-            [](XForm<num_t,rand_t>& a, XForm<num_t,rand_t>& b)
-            { return a.getWeight() > b.getWeight(); });
+        // stable so xforms with equal weights keep their order
+        std::vector<size_t> perm(xforms.size());
+        std::iota(perm.begin(),perm.end(),0);
+        std::stable_sort(perm.begin(),perm.end(),
+            [this](size_t a, size_t b)
+            { return xforms[a].getWeight() > xforms[b].getWeight(); });
+        permuteXForms(perm,getXFormOrder());
         std::for_each(xforms.begin(),xforms.end(),
             [](XForm<num_t,rand_t>& xf) { xf.optimize(); });
     }
+    // original index of each xform
+    std::vector<size_t> getXFormOrder() const
+    {
+        if (order.size() == xforms.size())
+            return order;
+        std::vector<size_t> ret(xforms.size());
+        std::iota(ret.begin(),ret.end(),0);
+        return ret;
+    }
+    // put the xforms in the order of another flame with the same xforms
+    // (getXFormOrder of it), so xform indexes mean the same xform in both
+    void setXFormOrder(const std::vector<size_t>& target)
+    {
+        std::vector<size_t> current = getXFormOrder();
+        std::vector<size_t> pos(xforms.size(),xforms.size());
+        for (size_t i = 0; i < current.size(); ++i)
+            pos[current[i]] = i;
+        std::vector<size_t> perm;
+        for (size_t orig : target)
+        {
+            if (orig >= pos.size() || pos[orig] == xforms.size())
+                throw std::runtime_error("xform order does not match flame");
+            perm.push_back(pos[orig]);
+            pos[orig] = xforms.size(); // each index once
+        }
+        if (perm.size() != xforms.size())
+            throw std::runtime_error("xform order does not match flame");
+        permuteXForms(perm,current);
+    }
+    // set rectangle bounds, throws error if they are invalid
+    void setBounds(num_t xmin, num_t xmax, num_t ymin, num_t ymax)
+    {
+        num_t M = max_rect<num_t>::value;
+        if (xmin < -M || xmin > M)
+            throw std::runtime_error("xmin out of bounds");
+        if (xmax < -M || xmax > M)
+            throw std::runtime_error("xmax out of bounds");
+        if (ymin < -M || ymin > M)
+            throw std::runtime_error("ymin out of bounds");
+        if (ymax < -M || ymax > M)
+            throw std::runtime_error("ymax out of bounds");
+        if (xmin >= xmax)
+            throw std::runtime_error("xmin >= xmax");
+        if (ymin >= ymax)
+            throw std::runtime_error("ymin >= ymax");
+        this->xmin = xmin;
+        this->xmax = xmax;
+        this->ymin = ymin;
+        this->ymax = ymax;
+    }
+    // set dimensions, throws error if they are invalid
+    void setSize(size_t size_x, size_t size_y)
+    {
+        if (size_x == 0 || size_x > max_dim)
+            throw std::runtime_error("size_x out of bounds");
+        if (size_y == 0 || size_y > max_dim)
+            throw std::runtime_error("size_y out of bounds");
+        this->size_x = size_x;
+        this->size_y = size_y;
+    }
+    // cumulative normalized xform weights for random xform selection
+    std::vector<num_t> getCumulativeWeights() const
+    {
+        std::vector<num_t> cw;
+        num_t wsum = 0.0;
+        for (auto& xf : xforms)
+            wsum += xf.getWeight();
+        num_t csum = 0.0;
+        for (auto& xf : xforms)
+        {
+            csum += xf.getWeight() / wsum;
+            cw.push_back(csum);
+        }
+        cw.back() = 1.0; // correct rounding error
+        return cw;
+    }
     inline const std::string& getName() const { return name; }
     inline size_t getSizeX() const { return size_x; }
     inline size_t getSizeY() const { return size_y; }
@@ -276,12 +476,125 @@ public:
     { return xforms; }
     inline bool hasFinalXForm() const { return has_final_xform; }
     const XForm<num_t,rand_t>& getFinalXForm() const { return final_xform; }
+    inline bool hasPalette() const { return has_palette; }
+    inline const std::vector<rgb_t<u8>>& getPalette() const { return palette; }
+};
+
+// estimate the attractor bounds (points after the final xform) by iterating
+// samples points, using the quantile and 1-quantile of each coordinate so
+// outliers are ignored, the rectangle is expanded by margin (fraction of its
+// size) on each side and to match the aspect ratio of the flame size
+// returns false if too few valid points were found
+template <typename num_t, typename rand_t>
+bool findFlameBounds(const Flame<num_t,rand_t>& flame, size_t samples,
+    num_t& xmin, num_t& xmax, num_t& ymin, num_t& ymax,
+    num_t quantile = 0.001, num_t margin = 0.02)
+{
+    rand_t rng;
+    IterState<num_t,rand_t> state(rng);
+    std::vector<num_t> cw = flame.getCumulativeWeights();
+    state.cw = cw.data();
+    const std::vector<XForm<num_t,rand_t>>& xfs = flame.getXForms();
+    std::vector<num_t> xs, ys;
+    xs.reserve(samples);
+    ys.reserve(samples);
+    state.p = state.randPoint();
+    // iterations left before points are used
+    size_t settle = settle_iters<num_t>::value;
+    for (size_t s = 0; s < samples; ++s)
+    {
+        xfs[state.randXFormIndex()].applyIteration(state);
+        if (bad_point(state.p.x,state.p.y))
+        {
+            state.p = state.randPoint();
+            settle = settle_iters<num_t>::value;
+            continue;
+        }
+        if (settle)
+        {
+            --settle;
+            continue;
+        }
+        Point2D<num_t> p = state.p;
+        if (flame.hasFinalXForm())
+        {
+            flame.getFinalXForm().applyIteration(state);
+            std::swap(p,state.p);
+        }
+        if (bad_point(p.x,p.y))
+            continue;
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+    }
+    if (xs.size() < 2)
+        return false;
+    size_t lo = (size_t)(quantile*(xs.size()-1));
+    size_t hi = xs.size()-1-lo;
+    std::nth_element(xs.begin(),xs.begin()+lo,xs.end());
+    std::nth_element(xs.begin(),xs.begin()+hi,xs.end());
+    std::nth_element(ys.begin(),ys.begin()+lo,ys.end());
+    std::nth_element(ys.begin(),ys.begin()+hi,ys.end());
+    xmin = xs[lo];
+    xmax = xs[hi];
+    ymin = ys[lo];
+    ymax = ys[hi];
+    // expand the smaller side to the aspect ratio of the image
+    num_t w = std::max(xmax-xmin,(num_t)eps<num_t>::value);
+    num_t h = std::max(ymax-ymin,(num_t)eps<num_t>::value);
+    num_t ratio = (num_t)flame.getSizeY() / flame.getSizeX();
+    if (h < w*ratio)
+        h = w*ratio;
+    else
+        w = h/ratio;
+    w *= 1.0 + 2.0*margin;
+    h *= 1.0 + 2.0*margin;
+    num_t xc = 0.5*(xmin+xmax);
+    num_t yc = 0.5*(ymin+ymax);
+    xmin = xc - 0.5*w;
+    xmax = xc + 0.5*w;
+    ymin = yc - 0.5*h;
+    ymax = yc + 0.5*h;
+    return true;
+}
+
+// reason for renderBufferParallel finishing
+enum render_status_t
+{
+    RENDER_DONE, // all samples rendered
+    RENDER_BAD_VALUES, // bad value limit reached
+    RENDER_LOW_PLOT_RATIO, // too few samples landing in the image
+    RENDER_CONVERGED, // image stopped changing
+    RENDER_CANCELLED, // cancel flag was set
+    RENDER_BAD_VALUE_RATE, // too many bad values per sample iterated
+    RENDER_SHRUNK // rendered with fewer samples after a failed rate check
+};
+
+// early termination checks for renderBufferParallel, done each time another
+// check_interval samples are completed
+struct RenderMonitor
+{
+    size_t check_interval;
+    // stop if plotted/iterated is below this (0 to disable)
+    double min_plot_ratio;
+    // stop if the relative change of the log scaled image since the previous
+    // check is below this (0 to disable)
+    double converge_threshold;
+    // stop when this is set, checked after every batch (null to disable)
+    const std::atomic<bool> *cancel;
+    // stop if bad values/iterated is above this (0 to disable)
+    double max_bad_value_rate;
+    // if nonzero, a failed plot ratio or bad value rate check multiplies the
+    // remaining samples by this instead of stopping the render
+    double shrink;
+    RenderMonitor(size_t check_interval = 1 << 24,
+            double min_plot_ratio = 0.0, double converge_threshold = 0.0,
+            const std::atomic<bool> *cancel = nullptr,
+            double max_bad_value_rate = 0.0, double shrink = 0.0):
+        check_interval(check_interval),min_plot_ratio(min_plot_ratio),
+        converge_threshold(converge_threshold),cancel(cancel),
+        max_bad_value_rate(max_bad_value_rate),shrink(shrink) {}
 };
 
-// TODO make mutex to use for bad value stuff and accumulate at end of render function
-// try with and without atomic operations for histogram incrementing
-// setup the termination if not enough samples land in the rectangle
-//
 // render histogram only (count of samples in each pixel)
 template <typename num_t, typename hist_t, typename rand_t>
 class RendererBasic
@@ -290,102 +603,496 @@ private:
     Flame<num_t,rand_t> flame;
     hist_t *histogram;
     bool hist_alloc; // is histogram allocated by this instance
+    size_t oversample; // histogram subpixels per image pixel (each axis)
+    size_t hist_x,hist_y; // histogram dimensions
+    // color sums per histogram cell of plotted samples, null if not
+    // rendering color, see color_mode_t, COLOR_RGB values are interleaved
+    color_mode_t color_mode;
+    size_t color_channels; // values per histogram cell in color_acc
+    hist_t *color_acc;
+    // hits of a cell included in its color sums (sums stay below max)
+    static constexpr hist_t color_max_count =
+        std::numeric_limits<hist_t>::max()/(palette_size-1);
+    filter_t filter; // filter for downsampling an oversampled histogram
+    // density estimation kernel radius (image pixels) is max / count^curve
+    // clamped to min, disabled if max is 0
+    num_t de_max_radius,de_min_radius,de_curve;
     num_t *cw; // cumulative weights for xform probability selection
     RendererBasic(){}
     // rendering statistics (current session)
     std::mutex mutex;
     size_t samples_iterated,samples_plotted;
-    std::vector<u32> bad_value_xforms; // last xforms leading to bad value
-    std::vector<Point2D<num_t>> bad_value_points; // points at bad value
+    // bad values so far (may pass the limit while threads are stopping)
+    std::atomic<size_t> bad_values;
+    // first xforms leading to bad values and the points (bounded, each
+    // thread logs its own and they are merged after each batch)
+    std::vector<u32> bad_value_xforms;
+    std::vector<Point2D<num_t>> bad_value_points;
     hist_t *xfdist; // xform selection (TODO maybe remove)
+    // profile of each xform and then the final xform (empty unless
+    // profile_enabled)
+    std::vector<XFormProfile> profile;
     num_t xmin,ymin,xmax,ymax;
+    // motion blur, flames at times spread over the shutter interval with the
+    // same xforms as flame, each chain uses a random one for a batch (empty
+    // if disabled)
+    std::vector<Flame<num_t,rand_t>> blur_flames;
+    std::vector<std::vector<num_t>> blur_cw; // cumulative weights for each
+    // mixed precision, plotted points are recomputed in double by repeating
+    // the last mixed_iters iterations from the point before them (null if
+    // disabled)
+    std::unique_ptr<Flame<double,rand_t>> precise_flame;
+    size_t mixed_iters;
+    // compiled iteration functions for flame (empty if not used)
+    IterKernel<num_t,rand_t> kernel;
+    // independent iteration chains for each render thread, consecutive
+    // samples alternate between them so their iterations can overlap
+    size_t chains;
+    // iteration state of a render thread kept between batches, so the points
+    // only have to settle at the start and after a bad value
+    struct WorkerState
+    {
+        bool settled;
+        Point2D<num_t> p[max_chains];
+        num_t c[max_chains];
+        // mixed precision ring buffers of recent points and xforms
+        size_t history[max_chains]; // iterations since the last settle
+        Point2D<num_t> ring_p[max_chains][max_mixed_iters];
+        u32 ring_xf[max_chains][max_mixed_iters];
+        // with motion blur, the point and color of each chain at each time
+        // (index bucket*max_chains+chain), so a chain settles once per time
+        // instead of every time a batch picks a new one
+        std::vector<Point2D<num_t>> blur_p;
+        std::vector<num_t> blur_c;
+        std::vector<u8> blur_settled;
+        // statistics for the current batch, merged at the end of it
+        std::vector<hist_t> xfdist;
+        std::vector<u32> bad_xforms;
+        std::vector<Point2D<num_t>> bad_points;
+        std::vector<XFormProfile> profile;
+        u32 profile_countdown; // iterations until the next timed one
+        bool profile_vars; // time the variations next instead of the xform
+        WorkerState(): settled(false),profile_countdown(profile_interval),
+            profile_vars(false) {}
+    };
+    // render threads and their rngs and states, kept between
+    // renderBufferParallel calls
+    std::shared_ptr<ThreadPool> pool;
+    std::vector<rand_t> rngs;
+    std::vector<WorkerState> workers;
+    // make the worker points settle again when the flame changes
+    void resetWorkers()
+    {
+        for (WorkerState& w : workers)
+        {
+            w.settled = false;
+            w.blur_settled.clear(); // sized for the buckets in renderSamples
+            w.profile.clear(); // sized for the flame in renderSamples
+        }
+    }
+    // zeroed profile counters for the xforms of flame
+    std::vector<XFormProfile> emptyProfile() const
+    {
+        std::vector<XFormProfile> ret;
+        if (!profile_enabled)
+            return ret;
+        for (const XForm<num_t,rand_t>& xf : flame.getXForms())
+            ret.push_back(XFormProfile(xf.getVariations().size()));
+        if (flame.hasFinalXForm())
+            ret.push_back(XFormProfile(
+                flame.getFinalXForm().getVariations().size()));
+        return ret;
+    }
+    RendererBasic(const RendererBasic&) = delete;
+    RendererBasic& operator=(const RendererBasic&) = delete;
 public:
     // construct a renderer object from a flame, optionally an existing buffer
     // buf != null to use existing buffer, maybe loaded from a file
-    RendererBasic(const Flame<num_t,rand_t>& flame, hist_t *buf = nullptr):
-        flame(flame),samples_iterated(0),samples_plotted(0),
+    // oversample > 1 makes the histogram that many times larger on each axis
+    // and images are filtered down to the flame size (the histogram, color
+    // buffer and .buf output stay oversample^2 times larger, filtering reads
+    // histogram rows directly except with density estimation, which makes
+    // a histogram size image first)
+    // color_mode to also accumulate palette colors (flame needs a palette)
+    RendererBasic(const Flame<num_t,rand_t>& flame, hist_t *buf = nullptr,
+            size_t oversample = 1, color_mode_t color_mode = COLOR_NONE):
+        flame(flame),oversample(oversample),
+        hist_x(flame.getSizeX()*oversample),
+        hist_y(flame.getSizeY()*oversample),color_mode(color_mode),
+        color_channels(color_mode == COLOR_RGB ? 3 : 1),color_acc(nullptr),
+        filter(FILTER_BOX),
+        de_max_radius(0.0),de_min_radius(0.0),de_curve(0.4),
+        samples_iterated(0),samples_plotted(0),bad_values(0),
         xmin(INFINITY),ymin(INFINITY),
-        xmax(-INFINITY),ymax(-INFINITY)
+        xmax(-INFINITY),ymax(-INFINITY),mixed_iters(0),
+        chains(1)
     {
+        if (oversample < 1 || oversample > max_oversample)
+            throw std::runtime_error("oversample out of bounds");
         this->flame.optimize();
         hist_alloc = buf == nullptr;
-        size_t X = flame.getSizeX();
-        size_t Y = flame.getSizeY();
         if (!buf)
-            histogram = new hist_t[X*Y]();
+            histogram = new hist_t[hist_x*hist_y]();
         else
             histogram = buf;
-        xfdist = new hist_t[flame.getXForms().size()]();
-        // compute normalized xform weights
-        std::vector<num_t> weights;
-        num_t wsum = 0.0;
-        for (auto xf : this->flame.getXForms())
+        if (color_mode != COLOR_NONE)
         {
-            weights.push_back(xf.getWeight());
-            wsum += xf.getWeight();
+            if (!flame.hasPalette())
+                throw std::runtime_error("color rendering requires a palette");
+            color_acc = new hist_t[color_channels*hist_x*hist_y]();
         }
-        for (size_t i = 0; i < weights.size(); ++i)
-            weights[i] /= wsum;
+        xfdist = new hist_t[flame.getXForms().size()]();
+        profile = emptyProfile();
         // cumulative weights for probability selection
+        std::vector<num_t> weights = this->flame.getCumulativeWeights();
         cw = new num_t[weights.size()];
-        wsum = 0.0;
-        for (size_t i = 0; i < weights.size(); ++i)
-        {
-            wsum += weights[i];
-            cw[i] = wsum;
-        }
-        cw[weights.size()-1] = 1.0; // correct rounding error
+        std::copy(weights.begin(),weights.end(),cw);
     }
     ~RendererBasic()
     {
         // deallocate histogram if this instance allocated it
         if (hist_alloc)
             delete[] histogram;
+        if (color_acc)
+            delete[] color_acc;
         delete[] xfdist;
         delete[] cw;
     }
-    void renderBuffer(size_t samples, rand_t& rng, size_t bad_value_limit = 10)
+    // replace the flame and clear the histogram and statistics so the same
+    // buffers, threads and rngs can render another flame of the same size
+    void setFlame(const Flame<num_t,rand_t>& flame)
+    {
+        if (flame.getSizeX()*oversample != hist_x
+                || flame.getSizeY()*oversample != hist_y)
+            throw std::runtime_error("flame size does not match renderer");
+        if (color_acc && !flame.hasPalette())
+            throw std::runtime_error("color rendering requires a palette");
+        this->flame = flame;
+        this->flame.optimize();
+        std::fill(histogram,histogram+hist_x*hist_y,0);
+        if (color_acc)
+            std::fill(color_acc,color_acc+color_channels*hist_x*hist_y,0);
+        delete[] xfdist;
+        xfdist = new hist_t[flame.getXForms().size()]();
+        profile = emptyProfile();
+        std::vector<num_t> weights = this->flame.getCumulativeWeights();
+        delete[] cw;
+        cw = new num_t[weights.size()];
+        std::copy(weights.begin(),weights.end(),cw);
+        samples_iterated = 0;
+        samples_plotted = 0;
+        bad_values = 0;
+        bad_value_xforms.clear();
+        bad_value_points.clear();
+        xmin = ymin = INFINITY;
+        xmax = ymax = -INFINITY;
+        blur_flames.clear();
+        blur_cw.clear();
+        precise_flame.reset();
+        kernel = IterKernel<num_t,rand_t>();
+        resetWorkers();
+    }
+    // flames to evaluate at random times within the shutter interval, the
+    // bounds and palette of the renderer flame are still used for plotting
+    // empty to disable motion blur (it is also cleared by setFlame)
+    void setMotionBlur(const std::vector<Flame<num_t,rand_t>>& flames)
+    {
+        if (flames.size() > max_blur_buckets)
+            throw std::runtime_error("too many motion blur flames");
+        if (precise_flame && !flames.empty())
+            throw std::runtime_error("motion blur with mixed precision");
+        if (kernel.iterate && !flames.empty())
+            throw std::runtime_error("motion blur with compiled kernel");
+        for (const Flame<num_t,rand_t>& f : flames)
+            if (f.getXForms().size() != flame.getXForms().size()
+                    || f.hasFinalXForm() != flame.hasFinalXForm())
+                throw std::runtime_error("motion blur flames do not match");
+        blur_flames = flames;
+        blur_cw.clear();
+        for (Flame<num_t,rand_t>& f : blur_flames)
+        {
+            // same xform order as flame (not sorted by the weights at each
+            // time) so xform indexes are the same in every bucket
+            f.setXFormOrder(flame.getXFormOrder());
+            blur_cw.push_back(f.getCumulativeWeights());
+        }
+        resetWorkers();
+    }
+    // iterate in num_t but recompute each plotted point in double from the
+    // point iters iterations before it, so the error of the num_t point is
+    // shrunk by the contraction of those iterations (only points near the
+    // bounds are recomputed, this is for zoomed views where num_t points
+    // are too coarse), flame must be the renderer flame made with double
+    // iters 0 disables it (it is also cleared by setFlame)
+    // the replay draws new random numbers, so variations using them (julia,
+    // julian, blur, noise, pie, ...) may take a different branch or offset
+    // than the num_t chain did, the recomputed point is still a valid point
+    // of the attractor but not the double version of the num_t point
+    void setMixedPrecision(const Flame<double,rand_t>& flame, size_t iters)
+    {
+        if (iters > max_mixed_iters)
+            throw std::runtime_error("mixed precision iterations too large");
+        resetWorkers();
+        if (!iters)
+        {
+            precise_flame.reset();
+            return;
+        }
+        if (!blur_flames.empty())
+            throw std::runtime_error("motion blur with mixed precision");
+        Flame<double,rand_t> precise = flame;
+        precise.setXFormOrder(this->flame.getXFormOrder());
+        const std::vector<XForm<num_t,rand_t>>& xfs = this->flame.getXForms();
+        bool match = precise.getSizeX() == this->flame.getSizeX()
+            && precise.getSizeY() == this->flame.getSizeY()
+            && precise.getXForms().size() == xfs.size()
+            && precise.hasFinalXForm() == this->flame.hasFinalXForm();
+        for (size_t i = 0; match && i < xfs.size(); ++i) // same order
+            match = (num_t)precise.getXForms()[i].getWeight()
+                == xfs[i].getWeight();
+        if (!match)
+            throw std::runtime_error("mixed precision flame does not match");
+        precise_flame.reset(new Flame<double,rand_t>(precise));
+        mixed_iters = iters;
+    }
+    // iterate with functions compiled for the renderer flame (see
+    // codegen.hpp) instead of the xform objects, the kernel must be made
+    // from the same flame, an empty kernel disables it (it is also cleared
+    // by setFlame)
+    void setKernel(const IterKernel<num_t,rand_t>& kernel)
+    {
+        if (kernel.iterate && !blur_flames.empty())
+            throw std::runtime_error("motion blur with compiled kernel");
+        if (kernel.iterate && flame.hasFinalXForm() != !!kernel.apply_final)
+            throw std::runtime_error("kernel does not match flame");
+        this->kernel = kernel;
+    }
+    inline bool hasKernel() const { return kernel.iterate != nullptr; }
+    // use a thread pool that may be shared with other renderers (only one
+    // of them can render at a time)
+    void setThreadPool(std::shared_ptr<ThreadPool> pool)
+    { this->pool = pool; }
+    // iteration chains interleaved by each render thread (1 to max_chains)
+    // the default 1 is fastest on the tested flames, K > 1 is 5-20% slower
+    // with the xform objects and with kernels because the random xform
+    // choice of each iteration mispredicts and flushes the other chains
+    void setChains(size_t chains)
+    {
+        if (chains < 1 || chains > max_chains)
+            throw std::runtime_error("chains out of bounds");
+        this->chains = chains;
+        resetWorkers();
+    }
+    inline size_t getChains() const { return chains; }
+    // iterate a state without plotting so it converges to the attractor
+    inline void settle(IterState<num_t,rand_t>& state) const
+    { settle(state,flame.getXForms().data()); }
+    // settle with the xforms of a motion blur time (state.cw must be its
+    // cumulative weights)
+    inline void settle(IterState<num_t,rand_t>& state,
+        const XForm<num_t,rand_t> *xfs) const
+    {
+        for (size_t s = 0; s < settle_iters<num_t>::value; ++s)
+        {
+            const XForm<num_t,rand_t>& xf = xfs[state.randXFormIndex()];
+            xf.applyIteration(state);
+            state.c = xf.applyColor(state.c);
+        }
+    }
+private:
+    // render samples continuing from the worker state, the mixed version
+    // keeps the recent points and xforms for recomputing plotted points with
+    // precise_flame, the interleave version alternates between the chains
+    template <bool mixed, bool interleave>
+    void renderSamples(size_t samples, rand_t& rng, WorkerState& w,
+        size_t bad_value_limit)
     {
-        if (bad_value_xforms.size() >= bad_value_limit)
+        if (bad_values >= bad_value_limit)
             return;
-        // state setup
-        IterState<num_t,rand_t> state(rng);
-        state.cw = cw;
-        state.p = state.randPoint();
+        // state setup for each chain, continuing from the previous batch if
+        // settled (the chains share the rng)
+        static_assert(max_chains == 8,"initialize a state for each chain");
+        IterState<num_t,rand_t> states[max_chains] =
+            { rng, rng, rng, rng, rng, rng, rng, rng };
         const std::vector<XForm<num_t,rand_t>>& xfs = flame.getXForms();
-        size_t flame_x = flame.getSizeX();
-        size_t flame_y = flame.getSizeY();
         bool has_final_xform = flame.hasFinalXForm();
+        bool color = color_mode != COLOR_NONE;
+        const rgb_t<u8> *palette = flame.getPalette().data();
         // multipliers for calculating coordinates in histogram
-        num_t xmul = (num_t)flame_x / (flame.getXMax() - flame.getXMin());
-        num_t ymul = (num_t)flame_y / (flame.getYMax() - flame.getYMin());
+        num_t xmul = (num_t)hist_x / (flame.getXMax() - flame.getXMin());
+        num_t ymul = (num_t)hist_y / (flame.getYMax() - flame.getYMin());
         // correction to ensure indexing in bounds
         xmul *= scale_adjust<num_t>::value;
         ymul *= scale_adjust<num_t>::value;
-        // get the point to converge to the attractor
-        for (size_t s = 0; s < settle_iters<num_t>::value; ++s)
-            xfs[state.randXFormIndex()].applyIteration(state);
+        // xform tables for each motion blur time (just flame if disabled)
+        size_t buckets = std::max((size_t)1,blur_flames.size());
+        const XForm<num_t,rand_t> *bucket_xfs[max_blur_buckets];
+        const XForm<num_t,rand_t> *bucket_final[max_blur_buckets];
+        num_t *bucket_cw[max_blur_buckets];
+        bucket_xfs[0] = xfs.data();
+        bucket_final[0] = &flame.getFinalXForm();
+        bucket_cw[0] = cw;
+        for (size_t b = 0; b < blur_flames.size(); ++b)
+        {
+            bucket_xfs[b] = blur_flames[b].getXForms().data();
+            bucket_final[b] = &blur_flames[b].getFinalXForm();
+            bucket_cw[b] = blur_cw[b].data();
+        }
+        if (buckets > 1 && w.blur_settled.size() < buckets*max_chains)
+        {
+            w.blur_p.resize(buckets*max_chains);
+            w.blur_c.resize(buckets*max_chains);
+            w.blur_settled.resize(buckets*max_chains,0);
+        }
+        // get the points to converge to the attractor
+        size_t bucket[max_chains]; // motion blur time of each chain
+        for (size_t k = 0; k < chains; ++k)
+        {
+            IterState<num_t,rand_t>& state = states[k];
+            // with motion blur, each chain stays at one random time in the
+            // shutter interval for the batch (continuing its point at that
+            // time or settled to the attractor there), so a trajectory never
+            // mixes xforms of different times, and the image averages the
+            // attractors over the times
+            bucket[k] = buckets > 1 ? state.randInt(buckets) : 0;
+            size_t j = bucket[k]*max_chains + k;
+            bool settled = buckets > 1 ? w.blur_settled[j] : w.settled;
+            state.cw = bucket_cw[bucket[k]];
+            if (settled)
+            {
+                state.p = buckets > 1 ? w.blur_p[j] : w.p[k];
+                state.c = buckets > 1 ? w.blur_c[j] : w.c[k];
+            }
+            else
+            {
+                state.p = state.randPoint();
+                state.c = state.randNum();
+                settle(state,bucket_xfs[bucket[k]]);
+                w.history[k] = 0;
+            }
+        }
+        w.settled = true;
+        size_t chain = 0;
         size_t samples_iterated_local = 0;
         size_t samples_plotted_local = 0;
-        hist_t *xfdist_local = new hist_t[flame.getXForms().size()]();
+        w.xfdist.resize(xfs.size()); // zeroed after each batch
+        hist_t *xfdist_local = w.xfdist.data();
+        if (profile_enabled && w.profile.empty()) // zeroed after each batch
+            w.profile = emptyProfile();
+        const XForm<num_t,rand_t> *final_xf = bucket_final[0];
+        // compiled xforms (null to use the xform objects)
+        u32 (*kernel_iterate)(IterState<num_t,rand_t>&) = kernel.iterate;
+        void (*kernel_final)(IterState<num_t,rand_t>&) = kernel.apply_final;
+        // mixed precision, points before the last iterations (ring buffer)
+        // and bounds with a margin for the error of the num_t point
+        static const size_t ring_mask = max_mixed_iters-1;
+        IterState<double,rand_t> pstate(rng);
+        const XForm<double,rand_t> *pxfs = nullptr, *pfinal = nullptr;
+        double pxmin = 0.0, pxmax = 0.0, pymin = 0.0, pymax = 0.0;
+        double pxmul = 0.0, pymul = 0.0;
+        num_t mxmin = 0.0, mxmax = 0.0, mymin = 0.0, mymax = 0.0;
+        if (mixed)
+        {
+            pxfs = precise_flame->getXForms().data();
+            pfinal = &precise_flame->getFinalXForm();
+            pxmin = precise_flame->getXMin();
+            pxmax = precise_flame->getXMax();
+            pymin = precise_flame->getYMin();
+            pymax = precise_flame->getYMax();
+            pxmul = hist_x / (pxmax-pxmin) * scale_adjust<double>::value;
+            pymul = hist_y / (pymax-pymin) * scale_adjust<double>::value;
+            // 2% of the size and 8 ulps (num_t) of the coordinates
+            double ulp = 8.0*emach<num_t>::value;
+            double mx = 0.02*(pxmax-pxmin)
+                + ulp*std::max(1.0,std::max(fabs(pxmin),fabs(pxmax)));
+            double my = 0.02*(pymax-pymin)
+                + ulp*std::max(1.0,std::max(fabs(pymin),fabs(pymax)));
+            mxmin = pxmin-mx;
+            mxmax = pxmax+mx;
+            mymin = pymin-my;
+            mymax = pymax+my;
+        }
         for (size_t s = 0; s < samples; ++s)
         {
             ++samples_iterated_local;
-            u32 xf_i = state.randXFormIndex();
-            const XForm<num_t,rand_t>& xf = xfs[xf_i];
+            // consecutive samples use the chains in turn
+            size_t k = interleave ? chain : 0;
+            IterState<num_t,rand_t>& state = states[k];
+            Point2D<num_t> *ring_p = w.ring_p[k];
+            u32 *ring_xf = w.ring_xf[k];
+            size_t& history = w.history[k];
+            if (interleave && ++chain == chains)
+                chain = 0;
+            const XForm<num_t,rand_t> *sample_xfs = bucket_xfs[0];
+            if (buckets > 1) // time of the chain
+            {
+                sample_xfs = bucket_xfs[bucket[k]];
+                final_xf = bucket_final[bucket[k]];
+            }
+            Point2D<num_t> prev = state.p;
+            u32 xf_i;
+            // when profiling, time 1 in profile_interval iterations
+            bool timed = profile_enabled && --w.profile_countdown == 0;
+            bool timed_vars = false;
+            u64 ticks = 0;
+            if (unlikely(timed))
+            {
+                w.profile_countdown = profile_interval;
+                timed_vars = w.profile_vars && !kernel_iterate;
+                w.profile_vars = !w.profile_vars;
+                ticks = profile_clock();
+            }
+            if (kernel_iterate) // selects and applies the xform
+                xf_i = kernel_iterate(state);
+            else
+            {
+                xf_i = state.randXFormIndex();
+                if (unlikely(timed_vars))
+                    sample_xfs[xf_i].applyIterationTimed(state,
+                        w.profile[xf_i].var_ticks.data());
+                else
+                    sample_xfs[xf_i].applyIteration(state);
+            }
+            if (unlikely(timed))
+            {
+                XFormProfile& xp = w.profile[xf_i];
+                if (timed_vars)
+                    ++xp.var_timed;
+                else
+                {
+                    xp.ticks += profile_clock()-ticks;
+                    ++xp.timed;
+                }
+            }
+            const XForm<num_t,rand_t>& xf = sample_xfs[xf_i];
             ++xfdist_local[xf_i];
-            xf.applyIteration(state);
-            if (unlikely(bad_value(state.p.x) || bad_value(state.p.y)))
+            if (mixed)
             {
-                mutex.lock();
-                bad_value_xforms.push_back(xf_i);
-                bad_value_points.push_back(state.p);
-                mutex.unlock();
-                if (bad_value_xforms.size() >= bad_value_limit)
+                ring_p[history & ring_mask] = prev;
+                ring_xf[history & ring_mask] = xf_i;
+                ++history;
+            }
+            if (color)
+                state.c = xf.applyColor(state.c);
+            if (unlikely(bad_point(state.p.x,state.p.y)))
+            {
+                if (w.bad_xforms.size() < max_bad_value_log)
+                {
+                    w.bad_xforms.push_back(xf_i);
+                    w.bad_points.push_back(state.p);
+                }
+                if (profile_enabled)
+                    ++w.profile[xf_i].bad_values;
+                if (++bad_values >= bad_value_limit)
+                {
+                    w.settled = false;
+                    if (buckets > 1)
+                        w.blur_settled[bucket[k]*max_chains+k] = 0;
                     break;
+                }
                 state.p = state.randPoint();
-                for (size_t s = 0; s < settle_iters<num_t>::value; ++s)
-                    xfs[state.randXFormIndex()].applyIteration(state);
+                settle(state,sample_xfs);
+                history = 0;
                 continue;
             }
             // update extreme coordinates
@@ -396,45 +1103,193 @@ public:
             if (has_final_xform) // update state.p to point to use
             {
                 Point2D<num_t> tmp = state.p;
-                flame.getFinalXForm().applyIteration(state);
+                XFormProfile *fp = timed ? &w.profile[xfs.size()] : nullptr;
+                if (unlikely(timed))
+                    ticks = profile_clock();
+                if (kernel_final)
+                    kernel_final(state);
+                else if (unlikely(timed_vars))
+                    final_xf->applyIterationTimed(state,fp->var_ticks.data());
+                else
+                    final_xf->applyIteration(state);
+                if (unlikely(timed))
+                {
+                    if (timed_vars)
+                        ++fp->var_timed;
+                    else
+                    {
+                        fp->ticks += profile_clock()-ticks;
+                        ++fp->timed;
+                    }
+                }
                 state.t = state.p;
                 state.p = tmp;
             }
             else
                 state.t = state.p;
-            // skip plotting if out of bounds
-            if (state.t.x < flame.getXMin() || state.t.x > flame.getXMax())
-                continue;
-            if (state.t.y < flame.getYMin() || state.t.y > flame.getYMax())
-                continue;
+            size_t x,y;
+            if (mixed) // repeat the last iterations in double
+            {
+                if (state.t.x < mxmin || state.t.x > mxmax
+                        || state.t.y < mymin || state.t.y > mymax)
+                    continue;
+                size_t n = std::min(mixed_iters,history);
+                const Point2D<num_t>& p0 = ring_p[(history-n) & ring_mask];
+                pstate.p = Point2D<double>(p0.x,p0.y);
+                for (size_t j = history-n; j < history; ++j)
+                    pxfs[ring_xf[j & ring_mask]].applyIteration(pstate);
+                if (has_final_xform)
+                    pfinal->applyIteration(pstate);
+                // also skips nan
+                if (!(pstate.p.x >= pxmin && pstate.p.x <= pxmax
+                        && pstate.p.y >= pymin && pstate.p.y <= pymax))
+                    continue;
+                x = (pstate.p.x - pxmin) * pxmul;
+                y = (pstate.p.y - pymin) * pymul;
+            }
+            else
+            {
+                // skip plotting if out of bounds
+                if (state.t.x < flame.getXMin() || state.t.x > flame.getXMax())
+                    continue;
+                if (state.t.y < flame.getYMin() || state.t.y > flame.getYMax())
+                    continue;
+                x = (state.t.x - flame.getXMin()) * xmul;
+                y = (state.t.y - flame.getYMin()) * ymul;
+            }
             // increment in histogram
-            size_t x = (state.t.x - flame.getXMin()) * xmul;
-            size_t y = (state.t.y - flame.getYMin()) * ymul;
-            //++histogram[flame_x*y + x];
-            __atomic_fetch_add(histogram+(flame_x*y + x),1,__ATOMIC_RELAXED);
+            size_t i = hist_x*y + x;
+            //++histogram[i];
+            hist_t n = __atomic_fetch_add(histogram+i,1,__ATOMIC_RELAXED);
             ++samples_plotted_local;
+            if (profile_enabled)
+                ++w.profile[xf_i].plotted;
+            // final xform color only applies to the plotted point, each
+            // count below color_max_count is returned to exactly one thread
+            if (color && n < color_max_count)
+            {
+                num_t c = has_final_xform
+                    ? final_xf->applyColor(state.c) : state.c;
+                size_t ci = std::min((size_t)(c*palette_size),palette_size-1);
+                if (color_mode == COLOR_INDEX)
+                    __atomic_fetch_add(color_acc+i,ci,__ATOMIC_RELAXED);
+                else
+                {
+                    const rgb_t<u8>& rgb = palette[ci];
+                    hist_t *acc = color_acc + 3*i;
+                    __atomic_fetch_add(acc,rgb.r,__ATOMIC_RELAXED);
+                    __atomic_fetch_add(acc+1,rgb.g,__ATOMIC_RELAXED);
+                    __atomic_fetch_add(acc+2,rgb.b,__ATOMIC_RELAXED);
+                }
+            }
+        }
+        for (size_t k = 0; k < chains; ++k)
+        {
+            size_t j = bucket[k]*max_chains + k;
+            if (buckets > 1 && w.settled)
+            {
+                w.blur_p[j] = states[k].p;
+                w.blur_c[j] = states[k].c;
+                w.blur_settled[j] = 1;
+            }
+            w.p[k] = states[k].p;
+            w.c[k] = states[k].c;
         }
         mutex.lock();
         samples_iterated += samples_iterated_local;
         samples_plotted += samples_plotted_local;
-        for (size_t i = 0; i < flame.getXForms().size(); ++i)
+        for (size_t i = 0; i < xfs.size(); ++i)
             xfdist[i] += xfdist_local[i];
+        for (size_t i = 0; i < w.bad_xforms.size()
+                && bad_value_xforms.size() < max_bad_value_log; ++i)
+        {
+            bad_value_xforms.push_back(w.bad_xforms[i]);
+            bad_value_points.push_back(w.bad_points[i]);
+        }
+        for (size_t i = 0; i < w.profile.size(); ++i)
+        {
+            profile[i].add(w.profile[i]);
+            w.profile[i].clear();
+        }
         mutex.unlock();
-        delete[] xfdist_local;
+        std::fill(w.xfdist.begin(),w.xfdist.end(),0);
+        w.bad_xforms.clear();
+        w.bad_points.clear();
+    }
+    void renderBatch(size_t samples, rand_t& rng, WorkerState& w,
+        size_t bad_value_limit)
+    {
+        if (precise_flame && chains > 1)
+            renderSamples<true,true>(samples,rng,w,bad_value_limit);
+        else if (precise_flame)
+            renderSamples<true,false>(samples,rng,w,bad_value_limit);
+        else if (chains > 1)
+            renderSamples<false,true>(samples,rng,w,bad_value_limit);
+        else
+            renderSamples<false,false>(samples,rng,w,bad_value_limit);
     }
-    void renderBufferParallel(size_t samples, size_t threads = 1,
+public:
+    // render samples on the calling thread starting from a new point
+    void renderBuffer(size_t samples, rand_t& rng, size_t bad_value_limit = 10)
+    {
+        WorkerState w;
+        renderBatch(samples,rng,w,bad_value_limit);
+    }
+    // render samples in batches split between threads
+    // stops early when the bad value limit is reached or a monitor check fails
+    // threads, their rngs and their points persist between calls (the points
+    // settle again after setFlame), thread_callback is only
+    // called when the thread pool is (re)created
+    render_status_t renderBufferParallel(size_t samples, size_t threads = 1,
             size_t batch_size = 1 << 16, size_t bad_value_limit = 10,
             std::function<void(float)> batch_callback = nullptr,
-            std::function<void(std::thread&,size_t)> thread_callback = nullptr)
+            std::function<void(std::thread&,size_t)> thread_callback = nullptr,
+            const RenderMonitor& monitor = RenderMonitor())
     {
         threads = std::min(threads,samples/batch_size+(samples%batch_size>0));
         std::mutex batch_mutex;
         size_t samples_progress = 0;
         size_t samples_total = samples;
+        render_status_t status = RENDER_DONE;
+        bool shrunk = false; // remaining samples reduced by a failed check
+        size_t next_check = monitor.check_interval;
+        bool checking = false; // a thread is doing a monitor check
+        std::vector<float> snapshot; // log image at previous check
+        // returns status to stop with, or RENDER_DONE to continue
+        auto check = [this,&monitor,&snapshot]()
+        {
+            mutex.lock();
+            size_t iterated = samples_iterated;
+            size_t plotted = samples_plotted;
+            mutex.unlock();
+            if (monitor.min_plot_ratio > 0.0 && iterated
+                    && (double)plotted/iterated < monitor.min_plot_ratio)
+                return RENDER_LOW_PLOT_RATIO;
+            if (monitor.max_bad_value_rate > 0.0 && iterated
+                    && (double)bad_values/iterated > monitor.max_bad_value_rate)
+                return RENDER_BAD_VALUE_RATE;
+            if (monitor.converge_threshold > 0.0)
+            {
+                std::vector<float> current = logSnapshot();
+                double diff = 0.0, total = 0.0;
+                for (size_t i = 0; i < snapshot.size(); ++i)
+                {
+                    diff += fabs(current[i]-snapshot[i]);
+                    total += snapshot[i];
+                }
+                bool first = snapshot.empty();
+                snapshot.swap(current);
+                if (!first && total > 0.0
+                        && diff/total < monitor.converge_threshold)
+                    return RENDER_CONVERGED;
+            }
+            return RENDER_DONE;
+        };
         auto thread_function = [this,&samples,&batch_mutex,&samples_progress,
-                &samples_total,&bad_value_limit,&batch_callback,&batch_size]()
+                &samples_total,&bad_value_limit,&batch_callback,&batch_size,
+                &status,&shrunk,&next_check,&checking,&check,&monitor]
+            (size_t index)
         {
-            rand_t rng; // unique random seeded rng for each thread
             for (;;)
             {
                 batch_mutex.lock(); // get next unit
@@ -446,68 +1301,510 @@ public:
                 size_t batch_samples = std::min(samples,batch_size);
                 samples -= batch_samples;
                 batch_mutex.unlock();
-                renderBuffer(batch_samples,rng,bad_value_limit);
+                renderBatch(batch_samples,rngs[index],workers[index],
+                    bad_value_limit);
+                bool bad_value_stop = bad_values >= bad_value_limit;
                 batch_mutex.lock(); // completed unit
                 samples_progress += batch_samples;
                 if (batch_callback)
                     batch_callback((float)samples_progress/samples_total);
+                if (bad_value_stop && status == RENDER_DONE)
+                {
+                    status = RENDER_BAD_VALUES;
+                    samples = 0;
+                }
+                if (samples && monitor.cancel && *monitor.cancel
+                        && status == RENDER_DONE)
+                {
+                    status = RENDER_CANCELLED;
+                    samples = 0;
+                }
+                bool do_check = samples && !checking
+                    && samples_progress >= next_check;
+                if (do_check)
+                {
+                    checking = true;
+                    next_check = samples_progress + monitor.check_interval;
+                }
+                batch_mutex.unlock();
+                if (!do_check)
+                    continue;
+                // other threads keep rendering during the check
+                render_status_t result = check();
+                batch_mutex.lock();
+                checking = false;
+                bool rate = result == RENDER_LOW_PLOT_RATIO
+                    || result == RENDER_BAD_VALUE_RATE;
+                if (rate && monitor.shrink > 0.0 && status == RENDER_DONE)
+                {
+                    size_t remaining = samples*monitor.shrink;
+                    samples_total -= samples-remaining;
+                    samples = remaining;
+                    shrunk = true;
+                }
+                else if (result != RENDER_DONE && status == RENDER_DONE)
+                {
+                    status = result;
+                    samples = 0;
+                }
                 batch_mutex.unlock();
             }
         };
-        std::vector<std::thread> thread_list;
-        batch_mutex.lock(); // start threads first
-        for (size_t i = 0; i < threads; ++i)
+        if (!pool || pool->size() < threads)
+            pool = std::make_shared<ThreadPool>(threads,thread_callback);
+        while (rngs.size() < threads) // unique random seeded rng per thread
+            rngs.push_back(rand_t());
+        if (workers.size() < threads)
+            workers.resize(threads);
+        if (!pool->run(thread_function,threads,monitor.cancel))
+            return RENDER_CANCELLED; // cancelled waiting for the pool
+        return status == RENDER_DONE && shrunk ? RENDER_SHRUNK : status;
+    }
+    // log scaled histogram averaged over square blocks so there are at most
+    // max_snapshot_dim blocks on each axis, normalized to a maximum of 1
+    // can be used while rendering (histogram is read with relaxed loads)
+    std::vector<float> logSnapshot() const
+    {
+        size_t sx,sy;
+        return logSnapshot(max_snapshot_dim,sx,sy);
+    }
+    // same as above with at most max_dim blocks on each axis, the snapshot
+    // size is stored in sx,sy (rows are bottom to top like the histogram)
+    std::vector<float> logSnapshot(size_t max_dim,
+        size_t& sx, size_t& sy) const
+    {
+        size_t b = std::max((hist_x+max_dim-1)/max_dim,
+                            (hist_y+max_dim-1)/max_dim);
+        sx = (hist_x+b-1)/b;
+        sy = (hist_y+b-1)/b;
+        std::vector<double> sums(sx*sy);
+        for (size_t y = 0; y < hist_y; ++y)
+            for (size_t x = 0; x < hist_x; ++x)
+                sums[sx*(y/b)+x/b] += __atomic_load_n(
+                    histogram+(hist_x*y+x),__ATOMIC_RELAXED);
+        std::vector<float> ret(sx*sy);
+        float max = 0.0;
+        for (size_t i = 0; i < sx*sy; ++i)
         {
-            thread_list.push_back(std::thread(thread_function));
-            if (thread_callback)
-                thread_callback(thread_list.back(),i);
+            ret[i] = log1p(sums[i]/(b*b));
+            max = std::max(max,ret[i]);
         }
-        batch_mutex.unlock();
-        for (size_t i = 0; i < threads; ++i)
-            thread_list[i].join();
+        if (max > 0.0)
+            for (float& v : ret)
+                v /= max;
+        return ret;
     }
-    template <typename pix_t>
-    pix_t *renderImage(std::function<num_t(hist_t)> scale, pix_t *buf = nullptr)
+    // lookup table of scale for the dense range of histogram values
+    // [0,min(max+1,max_scale_table)) since they are mostly small integers
+    std::vector<num_t> scaleTable(std::function<num_t(hist_t)> scale) const
     {
-        hist_t sample_min = -1;
         hist_t sample_max = 0;
         for (size_t i = 0; i < getHistogramSize(); ++i)
-        {
-            sample_min = std::min(sample_min,histogram[i]);
             sample_max = std::max(sample_max,histogram[i]);
+        size_t table_len = std::min((size_t)sample_max+1,max_scale_table);
+        std::vector<num_t> scale_table(table_len);
+        for (size_t i = 0; i < table_len; ++i)
+            scale_table[i] = scale((hist_t)i);
+        return scale_table;
+    }
+    // render image rows top to bottom, each row is passed to row_func and is
+    // only valid during that call, stops early if row_func returns false
+    // values above the scale table range call scale directly
+    // threads is used for density estimation and oversample filtering
+    template <typename pix_t>
+    bool renderImageRows(std::function<num_t(hist_t)> scale,
+        std::function<bool(const pix_t*)> row_func, size_t threads = 1)
+    {
+        std::vector<num_t> scale_table = scaleTable(scale);
+        size_t table_len = scale_table.size();
+        auto scaled = [&scale_table,&scale](hist_t n)
+        {
+            return likely(n < scale_table.size())
+                ? scale_table[n] : scale(n);
+        };
+        size_t X = flame.getSizeX();
+        std::vector<pix_t> img_row(X);
+        if (oversample > 1 || de_max_radius > 0.0)
+        {
+            std::vector<num_t> img = renderPlane(
+                [&scaled](size_t, hist_t n) { return scaled(n); },
+                table_len,threads);
+            num_t img_max = *std::max_element(img.begin(),img.end());
+            num_t mult = pix_scale<pix_t,num_t>::value / img_max;
+            for (size_t r = flame.getSizeY(); r--;)
+            {
+                const num_t *row = img.data() + X*r;
+                for (size_t c = 0; c < X; ++c)
+                    img_row[c] = (pix_t)(row[c]*mult);
+                if (!row_func(img_row.data()))
+                    return false;
+            }
+            return true;
         }
-        if (!buf)
-            buf = new pix_t[sizeof(pix_t)*getHistogramSize()];
         num_t scale_min = INFINITY;
         num_t scale_max = -INFINITY;
+        for (size_t i = 0; i < getHistogramSize(); ++i)
+        {
+            num_t scale_val = scaled(histogram[i]);
+            scale_min = std::min(scale_min,scale_val);
+            scale_max = std::max(scale_max,scale_val);
+        }
+        num_t mult = pix_scale<pix_t,num_t>::value / scale_max;
+        std::vector<pix_t> pix_table(table_len);
+        for (size_t i = 0; i < table_len; ++i)
+            pix_table[i] = (pix_t)(scale_table[i]*mult);
         for (size_t r = flame.getSizeY(); r--;)
-            for (size_t c = 0; c < flame.getSizeX(); ++c)
+        {
+            const hist_t *row = histogram + X*r;
+            for (size_t c = 0; c < X; ++c)
             {
-                hist_t buf_val = histogram[flame.getSizeX()*r + c];
-                num_t scale_val = scale(buf_val);
-                scale_min = std::min(scale_min,scale_val);
-                scale_max = std::max(scale_max,scale_val);
+                hist_t buf_val = row[c];
+                img_row[c] = likely(buf_val < table_len)
+                    ? pix_table[buf_val] : (pix_t)(scale(buf_val)*mult);
             }
-        pix_t *img_ptr = buf;
-        num_t mult = pix_scale<pix_t,num_t>::value / scale_max;
+            if (!row_func(img_row.data()))
+                return false;
+        }
+        return true;
+    }
+    // render color image rows (r,g,b interleaved) top to bottom, like
+    // renderImageRows, each pixel is its average color times the scaled
+    // count, normalized so the largest channel value is the maximum
+    template <typename pix_t>
+    bool renderColorImageRows(std::function<num_t(hist_t)> scale,
+        std::function<bool(const pix_t*)> row_func, size_t threads = 1)
+    {
+        if (!color_acc)
+            throw std::runtime_error("renderer has no color buffer");
+        std::vector<num_t> scale_table = scaleTable(scale);
+        size_t table_len = scale_table.size();
+        auto scaled = [&scale_table,&scale](hist_t n)
+        {
+            return likely(n < scale_table.size())
+                ? scale_table[n] : scale(n);
+        };
+        // average color channel (in [0,1]) of histogram index i with count n
+        const std::vector<rgb_t<u8>>& palette = flame.getPalette();
+        auto average = [&palette,this](size_t i, hist_t n, size_t ch)
+        {
+            n = std::min(n,color_max_count);
+            if (color_mode == COLOR_RGB)
+                return (num_t)color_acc[3*i+ch] / (num_t)(255.0*n);
+            // interpolate palette at the average index
+            num_t a = (num_t)color_acc[i] / (num_t)n;
+            size_t j = std::min((size_t)a,palette_size-1);
+            size_t k = std::min(j+1,palette_size-1);
+            num_t cj = ch == 0 ? palette[j].r : ch == 1 ? palette[j].g
+                : palette[j].b;
+            num_t ck = ch == 0 ? palette[k].r : ch == 1 ? palette[k].g
+                : palette[k].b;
+            return (cj + (a-j)*(ck-cj)) / (num_t)255.0;
+        };
+        std::vector<num_t> img[3];
+        num_t img_max = 0.0;
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            img[ch] = renderPlane([&scaled,&average,ch](size_t i, hist_t n)
+                {
+                    return n ? scaled(n) * average(i,n,ch) : (num_t)0.0;
+                },table_len,threads);
+            img_max = std::max(img_max,
+                *std::max_element(img[ch].begin(),img[ch].end()));
+        }
+        size_t X = flame.getSizeX();
+        std::vector<pix_t> img_row(3*X);
+        num_t mult = pix_scale<pix_t,num_t>::value / img_max;
         for (size_t r = flame.getSizeY(); r--;)
-            for (size_t c = 0; c < flame.getSizeX(); ++c)
+        {
+            for (size_t c = 0; c < X; ++c)
+                for (size_t ch = 0; ch < 3; ++ch)
+                    img_row[3*c+ch] = (pix_t)(img[ch][X*r+c]*mult);
+            if (!row_func(img_row.data()))
+                return false;
+        }
+        return true;
+    }
+    // image plane (flame size) from value(i,n) for histogram index i with
+    // count n, with density estimation and oversample filtering applied
+    template <typename F>
+    std::vector<num_t> renderPlane(F value, size_t table_len,
+        size_t threads) const
+    {
+        std::vector<num_t> img;
+        if (de_max_radius > 0.0)
+            img = densityEstimate(value,table_len,threads);
+        else if (oversample == 1)
+        {
+            img.resize(getHistogramSize());
+            for (size_t i = 0; i < getHistogramSize(); ++i)
+                img[i] = value(i,histogram[i]);
+            return img;
+        }
+        if (oversample == 1)
+            return img;
+        if (de_max_radius > 0.0)
+            return downsampleImage([&img,this](size_t y, num_t *row)
+                {
+                    const num_t *src = img.data() + hist_x*y;
+                    std::copy(src,src+hist_x,row);
+                },threads);
+        else
+            return downsampleImage([&value,this](size_t y, num_t *row)
+                {
+                    size_t i = hist_x*y;
+                    for (size_t c = 0; c < hist_x; ++c, ++i)
+                        row[c] = value(i,histogram[i]);
+                },threads);
+    }
+    // filter weights along one axis, image pixel i is computed from
+    // subpixels i*oversample+offset+k for k in [0,weights.size())
+    std::vector<num_t> filterWeights(i64& offset) const
+    {
+        std::vector<num_t> weights;
+        if (filter == FILTER_BOX)
+        {
+            offset = 0;
+            weights.assign(oversample,1.0/oversample);
+            return weights;
+        }
+        // gaussian with standard deviation of half a pixel, extending half a
+        // pixel past each side of the pixel
+        i64 pad = (oversample+1)/2;
+        offset = -pad;
+        num_t center = 0.5*oversample;
+        num_t sigma = 0.5*oversample;
+        num_t wsum = 0.0;
+        for (i64 k = -pad; k < (i64)oversample+pad; ++k)
+        {
+            num_t d = (k+0.5) - center;
+            weights.push_back(exp(-d*d/(2.0*sigma*sigma)));
+            wsum += weights.back();
+        }
+        for (num_t& w : weights)
+            w /= wsum;
+        return weights;
+    }
+    // filter scaled subpixels to the flame size, sub_row(y,row) must write
+    // the scaled histogram row y to row, image rows are split between threads
+    template <typename F>
+    std::vector<num_t> downsampleImage(F sub_row, size_t threads) const
+    {
+        size_t X = flame.getSizeX();
+        size_t Y = flame.getSizeY();
+        i64 offset;
+        std::vector<num_t> weights = filterWeights(offset);
+        size_t taps = weights.size();
+        std::vector<num_t> img(X*Y);
+        auto filter_rows = [&](size_t y_begin, size_t y_end)
+        {
+            std::vector<num_t> row(hist_x); // scaled subpixel row
+            for (size_t y = y_begin; y < y_end; ++y)
             {
-                hist_t buf_val = histogram[flame.getSizeX()*r + c];
-                *(img_ptr++) = (pix_t)(scale(buf_val)*mult);
+                num_t *out = img.data() + X*y;
+                for (size_t ky = 0; ky < taps; ++ky)
+                {
+                    i64 sy = (i64)(y*oversample) + offset + (i64)ky;
+                    sy = std::min(std::max(sy,(i64)0),(i64)hist_y-1);
+                    sub_row(sy,row.data());
+                    for (size_t x = 0; x < X; ++x)
+                    {
+                        num_t h = 0.0;
+                        for (size_t kx = 0; kx < taps; ++kx)
+                        {
+                            i64 sx = (i64)(x*oversample) + offset + (i64)kx;
+                            sx = std::min(std::max(sx,(i64)0),(i64)hist_x-1);
+                            h += weights[kx]*row[sx];
+                        }
+                        out[x] += weights[ky]*h;
+                    }
+                }
+            }
+        };
+        runRowRanges(Y,threads,filter_rows);
+        return img;
+    }
+    // density estimation kernel radius (subpixels) for a histogram count
+    // quantized to 1/de_radius_steps so kernels can be precomputed
+    num_t densityRadius(hist_t n) const
+    {
+        num_t r = de_max_radius*oversample / pow((num_t)n,de_curve);
+        r = std::max(std::min(r,de_max_radius*oversample),
+            de_min_radius*oversample);
+        return ceil(r*de_radius_steps) / de_radius_steps;
+    }
+    // adaptive density estimation (as in flam3), value(i,n) is the value for
+    // histogram index i with count n (usually the scaled count), it is spread
+    // with a gaussian kernel that is wider for smaller counts
+    // output is the size of the histogram
+    // source rows are split into bands between threads, each spreading into
+    // its own buffer (with room for kernels extending past the band)
+    template <typename F>
+    std::vector<num_t> densityEstimate(F value, size_t table_len,
+        size_t threads) const
+    {
+        // kernel tables, index i has radius i/de_radius_steps
+        num_t max_r = densityRadius(0);
+        size_t kernels = (size_t)(max_r*de_radius_steps) + 1;
+        std::vector<std::vector<num_t>> kernel(kernels);
+        std::vector<i64> kernel_half(kernels);
+        for (size_t i = 0; i < kernels; ++i)
+        {
+            num_t r = (num_t)i / de_radius_steps;
+            i64 h = r < 1.0 ? 0 : (i64)r; // radius below 1 does not spread
+            num_t sigma = 0.5*r;
+            std::vector<num_t>& k = kernel[i];
+            k.resize((2*h+1)*(2*h+1));
+            num_t ksum = 0.0;
+            for (i64 dy = -h; dy <= h; ++dy)
+                for (i64 dx = -h; dx <= h; ++dx)
+                {
+                    num_t d2 = dx*dx + dy*dy;
+                    num_t w = d2 > r*r ? 0.0 : exp(-d2/(2.0*sigma*sigma));
+                    if (h == 0)
+                        w = 1.0;
+                    k[(2*h+1)*(dy+h) + (dx+h)] = w;
+                    ksum += w;
+                }
+            for (num_t& w : k)
+                w /= ksum;
+            kernel_half[i] = h;
+        }
+        // kernel index for the dense range of counts
+        std::vector<u32> kernel_table(table_len);
+        for (size_t n = 0; n < table_len; ++n)
+            kernel_table[n] = (u32)(densityRadius(n)*de_radius_steps);
+        i64 H = kernel_half[kernels-1]; // maximum kernel extent
+        size_t bands = std::max((size_t)1,std::min(threads,hist_y));
+        std::vector<std::vector<num_t>> band_buf(bands);
+        std::vector<i64> band_y0(bands+1);
+        for (size_t b = 0; b <= bands; ++b)
+            band_y0[b] = hist_y*b/bands;
+        auto spread_rows = [&](size_t b)
+        {
+            i64 y_begin = band_y0[b];
+            i64 y_end = band_y0[b+1];
+            i64 buf_y0 = y_begin - H; // buffer row 0 is histogram row buf_y0
+            std::vector<num_t>& buf = band_buf[b];
+            buf.assign(hist_x*(y_end-y_begin+2*H),0.0);
+            for (i64 y = y_begin; y < y_end; ++y)
+            {
+                const hist_t *row = histogram + hist_x*y;
+                for (i64 x = 0; x < (i64)hist_x; ++x)
+                {
+                    hist_t n = row[x];
+                    num_t v = value(hist_x*y+x,n);
+                    if (v == 0.0)
+                        continue;
+                    u32 ki = likely(n < table_len) ? kernel_table[n]
+                        : (u32)(densityRadius(n)*de_radius_steps);
+                    i64 h = kernel_half[ki];
+                    const num_t *k = kernel[ki].data();
+                    i64 x0 = std::max(x-h,(i64)0);
+                    i64 x1 = std::min(x+h,(i64)hist_x-1);
+                    for (i64 dy = -h; dy <= h; ++dy)
+                    {
+                        if (y+dy < 0 || y+dy >= (i64)hist_y)
+                            continue;
+                        num_t *out = buf.data() + hist_x*(y+dy-buf_y0);
+                        // kernel index of histogram column xx is kx+xx
+                        i64 kx = (2*h+1)*(dy+h) + h - x;
+                        for (i64 xx = x0; xx <= x1; ++xx)
+                            out[xx] += v*k[kx+xx];
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> thread_list;
+        for (size_t b = 0; b < bands; ++b)
+            thread_list.push_back(std::thread(spread_rows,b));
+        for (size_t b = 0; b < bands; ++b)
+            thread_list[b].join();
+        // sum band buffers, a row is covered by its own band and the halo of
+        // neighboring bands
+        std::vector<num_t> img(hist_x*hist_y);
+        runRowRanges(hist_y,threads,[&](size_t y_begin, size_t y_end)
+        {
+            for (size_t b = 0; b < bands; ++b)
+            {
+                i64 lo = std::max((i64)y_begin,band_y0[b]-H);
+                i64 hi = std::min((i64)y_end,band_y0[b+1]+H);
+                for (i64 y = lo; y < hi; ++y)
+                {
+                    const num_t *src = band_buf[b].data()
+                        + hist_x*(y-(band_y0[b]-H));
+                    num_t *out = img.data() + hist_x*y;
+                    for (size_t x = 0; x < hist_x; ++x)
+                        out[x] += src[x];
+                }
             }
+        });
+        return img;
+    }
+    // split rows [0,rows) into contiguous ranges, func(begin,end) is called
+    // for each range on its own thread
+    template <typename F>
+    static void runRowRanges(size_t rows, size_t threads, F func)
+    {
+        threads = std::max((size_t)1,std::min(threads,rows));
+        std::vector<std::thread> thread_list;
+        for (size_t i = 0; i < threads; ++i)
+            thread_list.push_back(std::thread(func,
+                rows*i/threads,rows*(i+1)/threads));
+        for (size_t i = 0; i < threads; ++i)
+            thread_list[i].join();
+    }
+    template <typename pix_t>
+    pix_t *renderImage(std::function<num_t(hist_t)> scale, pix_t *buf = nullptr)
+    {
+        if (!buf)
+            buf = new pix_t[sizeof(pix_t)*getHistogramSize()];
+        pix_t *img_ptr = buf;
+        size_t X = flame.getSizeX();
+        renderImageRows<pix_t>(scale,[&img_ptr,X](const pix_t *row)
+        {
+            std::copy(row,row+X,img_ptr);
+            img_ptr += X;
+            return true;
+        });
         return buf;
     }
     inline const Flame<num_t,rand_t>& getFlame() const { return flame; }
     inline const hist_t *getHistogram() const { return histogram; }
     inline hist_t *getHistogram() { return histogram; }
     size_t getHistogramSizeBytes() const
-    { return sizeof(hist_t)*flame.getSizeX()*flame.getSizeY(); };
-    size_t getHistogramSize() const
-    { return flame.getSizeX()*flame.getSizeY(); }
+    { return sizeof(hist_t)*hist_x*hist_y; };
+    size_t getHistogramSize() const { return hist_x*hist_y; }
+    inline size_t getHistogramSizeX() const { return hist_x; }
+    inline size_t getHistogramSizeY() const { return hist_y; }
+    inline size_t getOversample() const { return oversample; }
+    inline bool hasColor() const { return color_acc != nullptr; }
+    inline color_mode_t getColorMode() const { return color_mode; }
+    inline const hist_t *getColorBuffer() const { return color_acc; }
+    inline hist_t *getColorBuffer() { return color_acc; }
+    size_t getColorBufferSizeBytes() const
+    { return color_acc ? color_channels*getHistogramSizeBytes() : 0; }
+    inline filter_t getFilter() const { return filter; }
+    inline void setFilter(filter_t f) { filter = f; }
+    // set density estimation parameters, max_radius = 0 disables it
+    void setDensityEstimation(num_t max_radius, num_t min_radius = 0.0,
+        num_t curve = 0.4)
+    {
+        if (max_radius < 0.0 || max_radius > max_de_radius)
+            throw std::runtime_error("de radius out of bounds");
+        if (min_radius < 0.0 || min_radius > max_radius)
+            throw std::runtime_error("de min radius out of bounds");
+        if (curve <= 0.0)
+            throw std::runtime_error("de curve must be positive");
+        de_max_radius = max_radius;
+        de_min_radius = min_radius;
+        de_curve = curve;
+    }
     inline size_t getXFormsLength() const { return flame.getXForms().size(); }
     inline const hist_t *getXFormDistribution() const { return xfdist; }
-    inline size_t getBadValueCount() const { return bad_value_xforms.size(); }
+    // xform profiles (final xform last), empty unless profile_enabled
+    inline const std::vector<XFormProfile>& getProfile() const
+    { return profile; }
+    inline size_t getBadValueCount() const { return bad_values; }
     inline size_t getSamplesPlotted() const { return samples_plotted; }
     inline size_t getSamplesIterated() const { return samples_iterated; }
     inline const std::vector<u32>& getBadValueXForms() const
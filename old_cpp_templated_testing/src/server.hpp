@@ -0,0 +1,420 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "batch.hpp"
+#include "json_small.hpp"
+#include "renderer.hpp"
+#include "thread_pool.hpp"
+#include "types.hpp"
+
+namespace tkoz
+{
+namespace flame
+{
+
+/*
+long running render server, requests are JSON objects, one per line:
+    "flame": flame JSON object (required)
+    "samples": samples to render (required)
+    "session": name (default ""), a request cancels the previous render of
+        its session
+    "id": any JSON value, copied to the responses (default null)
+    "type": image type given to the encoder or "buf" for the raw histogram
+        (and color buffer) (default "png")
+    "progress": number of images sent, the first after samples/4^(n-1) and
+        each later one after 4 times as many samples (default 1)
+    "cancel": true to only cancel the current render of the session
+responses are a JSON header line with "id", "session", "status" (progress,
+done, cancelled, error), "samples" (iterated so far), "bytes" and "error"
+(for status error), followed by that many bytes of image data
+renders share one thread pool (one render iterates at a time) and recycled
+histograms, so nothing is started or allocated per request
+the reader does not wait for cancelled renders, a new render of a session
+waits for the previous one (so its responses come after) and a finished
+render removes its session
+*/
+template <typename num_t, typename hist_t, typename rand_t>
+class RenderServer
+{
+private:
+    typedef RendererBasic<num_t,hist_t,rand_t> renderer_t;
+    // connection output, writes of a response are not interleaved
+    struct Connection
+    {
+        int fd;
+        bool close_fd; // close when the last render using it finishes
+        std::mutex mutex;
+        Connection(int fd, bool close_fd): fd(fd),close_fd(close_fd) {}
+        ~Connection()
+        {
+            if (close_fd)
+                close(fd);
+        }
+        bool send(const std::string& header, const std::string& data)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return sendAll(header) && sendAll(data);
+        }
+        bool sendAll(const std::string& s)
+        {
+            for (size_t i = 0; i < s.size();)
+            {
+                ssize_t n = write(fd,s.data()+i,s.size()-i);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                i += n;
+            }
+            return true;
+        }
+    };
+    struct Session
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> cancel; // also identifies a render
+        std::shared_ptr<Connection> connection;
+    };
+    std::shared_ptr<ThreadPool> pool;
+    HistogramPool<hist_t> hist_pool;
+    size_t oversample;
+    color_mode_t color_mode;
+    size_t batch_size;
+    size_t bad_value_limit;
+    size_t chains;
+    // makes an image of the given type, false if the type is not supported
+    std::function<bool(renderer_t&,std::ostream&,const std::string&)> encode;
+    std::mutex sessions_mutex;
+    std::condition_variable sessions_cv; // notified when a render finishes
+    std::unordered_map<std::string,Session> sessions;
+    std::vector<std::thread> finished; // renders that removed their session
+    RenderServer(const RenderServer&) = delete;
+    RenderServer& operator=(const RenderServer&) = delete;
+    static std::string header(const Json& id, const std::string& session,
+        const std::string& status, size_t samples, size_t bytes,
+        const std::string& error = "")
+    {
+        Json h(nlohmann::json::object());
+        h.setValue("id",id);
+        h.setValue("session",Json(nlohmann::json(session)));
+        h.setValue("status",Json(nlohmann::json(status)));
+        h.setValue("samples",Json(nlohmann::json(samples)));
+        h.setValue("bytes",Json(nlohmann::json(bytes)));
+        if (!error.empty())
+            h.setValue("error",Json(nlohmann::json(error)));
+        std::ostringstream os;
+        os << h << '\n';
+        return os.str();
+    }
+    // join renders that have finished, they are exiting so this is quick
+    void reapFinished()
+    {
+        std::vector<std::thread> threads;
+        sessions_mutex.lock();
+        threads.swap(finished);
+        sessions_mutex.unlock();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+    // called by a render when it finishes, removes its session unless a
+    // newer render replaced it (which then joins this one)
+    void finishSession(const std::string& name,
+        const std::shared_ptr<std::atomic<bool>>& cancel)
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto iter = sessions.find(name);
+        if (iter != sessions.end() && iter->second.cancel == cancel)
+        {
+            if (iter->second.thread.joinable())
+                finished.push_back(std::move(iter->second.thread));
+            sessions.erase(iter);
+        }
+        sessions_cv.notify_all();
+    }
+    // render a request, sending images after each progress step, previous is
+    // the replaced render of the session which must finish first
+    void renderRequest(const Json& request, std::shared_ptr<Connection> conn,
+        std::shared_ptr<std::atomic<bool>> cancel, std::thread previous)
+    {
+        if (previous.joinable())
+            previous.join();
+        Json id, value;
+        request.valueAt("id",id);
+        std::string session = request.valueAt("session",value)
+            ? value.stringValue() : "";
+        hist_t *buf = nullptr;
+        size_t len = 0;
+        try
+        {
+            // do not wait for the thread pool if already replaced
+            if (*cancel)
+            {
+                conn->send(header(id,session,"cancelled",0,0),"");
+                finishSession(session,cancel);
+                return;
+            }
+            Flame<num_t,rand_t> flame(request["flame"]);
+            size_t samples = request["samples"].intValue();
+            std::string type = request.valueAt("type",value)
+                ? value.stringValue() : "png";
+            size_t progress = request.valueAt("progress",value)
+                ? value.intValue() : 1;
+            if (progress < 1 || progress > 16)
+                throw std::runtime_error("progress must be 1-16");
+            len = flame.getSizeX()*flame.getSizeY()*oversample*oversample;
+            buf = hist_pool.acquire(len);
+            renderer_t renderer(flame,buf,oversample,color_mode);
+            renderer.setThreadPool(pool);
+            renderer.setChains(chains);
+            RenderMonitor monitor(1 << 24,0.0,0.0,cancel.get());
+            size_t done = 0;
+            for (size_t step = 0; step < progress; ++step)
+            {
+                size_t target = samples >> (2*(progress-1-step));
+                render_status_t status = *cancel ? RENDER_CANCELLED
+                    : renderer.renderBufferParallel(target-done,pool->size(),
+                        batch_size,bad_value_limit,nullptr,nullptr,monitor);
+                done = target;
+                if (status == RENDER_CANCELLED)
+                {
+                    conn->send(header(id,session,"cancelled",
+                        renderer.getSamplesIterated(),0),"");
+                    break;
+                }
+                std::ostringstream os;
+                if (type == "buf")
+                {
+                    os.write((const char*)renderer.getHistogram(),
+                        renderer.getHistogramSizeBytes());
+                    os.write((const char*)renderer.getColorBuffer(),
+                        renderer.getColorBufferSizeBytes());
+                }
+                else if (!encode(renderer,os,type))
+                    throw std::runtime_error("unsupported type");
+                bool last = step+1 == progress || status != RENDER_DONE;
+                std::string data = os.str();
+                if (!conn->send(header(id,session,last ? "done" : "progress",
+                        renderer.getSamplesIterated(),data.size()),data))
+                    break; // connection closed
+                if (last)
+                    break;
+            }
+        }
+        catch (std::exception& e)
+        {
+            conn->send(header(id,session,"error",0,0,e.what()),"");
+        }
+        if (buf)
+            hist_pool.release(buf,len);
+        finishSession(session,cancel);
+    }
+public:
+    // renderer options are the same as for RendererBasic
+    RenderServer(size_t threads,
+            std::function<bool(renderer_t&,std::ostream&,const std::string&)>
+                encode,
+            size_t oversample = 1, color_mode_t color_mode = COLOR_NONE,
+            size_t batch_size = 1 << 16, size_t bad_value_limit = 10):
+        pool(std::make_shared<ThreadPool>(threads)),oversample(oversample),
+        color_mode(color_mode),batch_size(batch_size),
+        bad_value_limit(bad_value_limit),chains(1),encode(encode) {}
+    // iteration chains per thread (see RendererBasic::setChains), set
+    // before serving requests
+    void setChains(size_t chains)
+    {
+        if (chains < 1 || chains > max_chains)
+            throw std::runtime_error("chains out of bounds");
+        this->chains = chains;
+    }
+    // cancels all renders and waits for them
+    ~RenderServer()
+    {
+        std::unique_lock<std::mutex> lock(sessions_mutex);
+        for (auto& entry : sessions)
+            *entry.second.cancel = true;
+        pool->wake();
+        sessions_cv.wait(lock,[this]() { return sessions.empty(); });
+        lock.unlock();
+        reapFinished();
+    }
+    // handle requests read from in_fd with responses written to out_fd until
+    // end of input, renders started from this stream are then cancelled
+    // (cancel_at_end) or finished
+    void serveStream(int in_fd, int out_fd, bool close_fds = false,
+        bool cancel_at_end = false)
+    {
+        std::shared_ptr<Connection> conn =
+            std::make_shared<Connection>(out_fd,close_fds);
+        std::string pending;
+        char chunk[1 << 16];
+        for (;;)
+        {
+            size_t newline = pending.find('\n');
+            if (newline == std::string::npos)
+            {
+                ssize_t n = read(in_fd,chunk,sizeof(chunk));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    break;
+                pending.append(chunk,n);
+                continue;
+            }
+            std::string line = pending.substr(0,newline);
+            pending.erase(0,newline+1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            Json request, value, id;
+            std::string session;
+            try
+            {
+                request = Json(line);
+                request.valueAt("id",id);
+                session = request.valueAt("session",value)
+                    ? value.stringValue() : "";
+            }
+            catch (std::exception& e)
+            {
+                conn->send(header(id,session,"error",0,0,e.what()),"");
+                continue;
+            }
+            bool cancel_only = request.valueAt("cancel",value)
+                && value.isBool() && value.boolValue();
+            reapFinished();
+            std::lock_guard<std::mutex> lock(sessions_mutex);
+            auto iter = sessions.find(session);
+            if (iter != sessions.end())
+            {
+                *iter->second.cancel = true;
+                pool->wake(); // it may be waiting for the pool
+            }
+            if (cancel_only)
+                continue; // the cancelled render removes its session
+            // the new render joins the one it replaces
+            std::thread previous;
+            if (iter != sessions.end())
+                previous.swap(iter->second.thread);
+            Session& s = sessions[session];
+            s.cancel = std::make_shared<std::atomic<bool>>(false);
+            s.connection = conn;
+            s.thread = std::thread(&RenderServer::renderRequest,this,
+                request,conn,s.cancel,std::move(previous));
+        }
+        // renders of a replaced session are waited for by their successor
+        std::unique_lock<std::mutex> lock(sessions_mutex);
+        for (auto& entry : sessions)
+            if (entry.second.connection == conn && cancel_at_end)
+                *entry.second.cancel = true;
+        pool->wake();
+        sessions_cv.wait(lock,[this,&conn]()
+        {
+            for (auto& entry : sessions)
+                if (entry.second.connection == conn)
+                    return false;
+            return true;
+        });
+        lock.unlock();
+        reapFinished();
+        if (close_fds && in_fd != out_fd)
+            close(in_fd);
+    }
+    // listen on a UNIX domain socket, each connection is served on its own
+    // thread, returns false if the socket cannot be created or accept fails
+    // (after closing the connections and waiting for their threads)
+    bool serveSocket(const std::string& path)
+    {
+        // control is a duplicate of the connection fd for shutting it down,
+        // so it stays valid after serveStream closes the connection
+        struct Client
+        {
+            std::thread thread;
+            int control;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+        std::vector<Client> clients;
+        auto reap = [&clients](bool all)
+        {
+            for (size_t i = 0; i < clients.size();)
+            {
+                if (!all && !*clients[i].done)
+                {
+                    ++i;
+                    continue;
+                }
+                if (all) // end of input for serveStream
+                    shutdown(clients[i].control,SHUT_RDWR);
+                clients[i].thread.join();
+                close(clients[i].control);
+                clients.erase(clients.begin()+i);
+            }
+        };
+        signal(SIGPIPE,SIG_IGN); // closed connections are write errors
+        int fd = socket(AF_UNIX,SOCK_STREAM,0);
+        if (fd < 0)
+            return false;
+        sockaddr_un addr;
+        memset(&addr,0,sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            close(fd);
+            return false;
+        }
+        strcpy(addr.sun_path,path.c_str());
+        unlink(path.c_str());
+        if (bind(fd,(sockaddr*)&addr,sizeof(addr)) < 0 || listen(fd,16) < 0)
+        {
+            close(fd);
+            return false;
+        }
+        for (;;)
+        {
+            int client = accept(fd,nullptr,nullptr);
+            if (client < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+            reap(false);
+            Client c;
+            c.control = dup(client);
+            if (c.control < 0)
+            {
+                close(client);
+                continue;
+            }
+            c.done = std::make_shared<std::atomic<bool>>(false);
+            std::shared_ptr<std::atomic<bool>> done = c.done;
+            c.thread = std::thread([this,client,done]()
+            {
+                serveStream(client,client,true,true);
+                *done = true;
+            });
+            clients.push_back(std::move(c));
+        }
+        close(fd);
+        reap(true);
+        return false;
+    }
+};
+
+}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace tkoz
+{
+namespace flame
+{
+
+// fixed set of worker threads kept alive between jobs so repeated renders
+// (animation frames, queued flames) do not start new threads every time
+class ThreadPool
+{
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    bool busy; // a job is running, one job at a time
+    std::condition_variable start_cv,done_cv,idle_cv;
+    std::function<void(size_t)> job; // current job, given the worker index
+    size_t job_id; // incremented for each job
+    size_t job_workers; // workers used by the current job
+    size_t running; // workers still running the current job
+    bool stopping;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    void workerLoop(size_t index)
+    {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            start_cv.wait(lock,[this,&seen]()
+                { return stopping || job_id != seen; });
+            if (stopping)
+                return;
+            seen = job_id;
+            if (index >= job_workers)
+                continue;
+            lock.unlock();
+            job(index);
+            lock.lock();
+            if (--running == 0)
+                done_cv.notify_all();
+        }
+    }
+public:
+    // start size worker threads, thread_callback is called for each one
+    ThreadPool(size_t size,
+            std::function<void(std::thread&,size_t)> thread_callback = nullptr):
+        busy(false),job_id(0),job_workers(0),running(0),stopping(false)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            threads.push_back(std::thread(&ThreadPool::workerLoop,this,i));
+            if (thread_callback)
+                thread_callback(threads.back(),i);
+        }
+    }
+    ~ThreadPool()
+    {
+        mutex.lock();
+        stopping = true;
+        mutex.unlock();
+        start_cv.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+    inline size_t size() const { return threads.size(); }
+    // run func(i) on workers i = 0..workers-1 and wait for all of them
+    // not run if cancel is set, also while waiting for another job to
+    // finish (whoever sets it must call wake), returns false if not run
+    bool run(std::function<void(size_t)> func, size_t workers,
+        const std::atomic<bool> *cancel = nullptr)
+    {
+        if (workers > threads.size())
+            throw std::runtime_error("not enough threads in pool");
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_cv.wait(lock,[this,cancel]()
+            { return !busy || (cancel && *cancel); });
+        if (busy || (cancel && *cancel))
+            return false;
+        busy = true;
+        job = func;
+        job_workers = workers;
+        running = workers;
+        ++job_id;
+        start_cv.notify_all();
+        done_cv.wait(lock,[this]() { return running == 0; });
+        job = nullptr;
+        busy = false;
+        idle_cv.notify_all();
+        return true;
+    }
+    // wake calls of run waiting for the pool to check their cancel flag
+    void wake()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle_cv.notify_all();
+    }
+};
+
+}
+}
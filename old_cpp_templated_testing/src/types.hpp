@@ -4,13 +4,20 @@ Types for flame fractal renderer. In templates, num_t is float or double.
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <ctgmath>
 #include <functional>
 #include <iostream>
 #include <unordered_map>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 #include "isaac.hpp"
 #include "jrand.hpp"
 #include "json_small.hpp"
@@ -54,6 +61,68 @@ template <typename T> struct max_rect {};
 template <> struct max_rect<float> { static constexpr float value = 1e5F; };
 template <> struct max_rect<double> { static constexpr double value = 1e10; };
 
+// maximum histogram subpixels per image pixel (each axis)
+static const size_t max_oversample = 16;
+
+// filters for downsampling an oversampled histogram to the image size
+enum filter_t { FILTER_BOX, FILTER_GAUSSIAN };
+
+// density estimation limits, maximum kernel radius (image pixels) and
+// kernel radius quantization (precomputed kernels per 1/steps pixels)
+static const size_t max_de_radius = 32;
+static const size_t de_radius_steps = 4;
+
+// number of palette entries, flame palettes are interpolated to this size
+static const size_t palette_size = 256;
+
+// color accumulation per histogram cell
+// COLOR_INDEX - sum of palette indexes (1 value), the color is the palette
+//   interpolated at the average index
+// COLOR_RGB - sums of palette colors (3 values), exact average color, a
+//   slow path (about 1.7x grayscale time vs 1.25x for COLOR_INDEX) because
+//   each plotted point does 3 atomic adds instead of 1
+// sums are hist_t and only include the first max/255 hits of a cell (about
+// 16.8M for u32), so they cannot wrap and the average stays exact for them
+enum color_mode_t { COLOR_NONE, COLOR_INDEX, COLOR_RGB };
+
+// maximum size (each axis) of histogram snapshots for convergence checks
+static const size_t max_snapshot_dim = 512;
+
+// maximum number of time buckets for motion blur
+static const size_t max_blur_buckets = 256;
+
+// maximum iterations repeated in double for mixed precision rendering
+static const size_t max_mixed_iters = 64;
+
+// maximum independent iteration chains interleaved by each render thread
+static const size_t max_chains = 8;
+
+// maximum bad values (xforms and points) kept for diagnostics
+static const size_t max_bad_value_log = 64;
+
+// iteration profiling, build with -DFLAME_PROFILE to count plotted samples
+// and bad values for each xform and time 1 in profile_interval iterations,
+// otherwise the profiling code is compiled out
+#ifdef FLAME_PROFILE
+static const bool profile_enabled = true;
+#else
+static const bool profile_enabled = false;
+#endif
+static const u32 profile_interval = 64;
+
+// timer for profiling (cpu timestamp counter ticks if available)
+inline u64 profile_clock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// histogram values below this are scaled with a lookup table for images
+static const size_t max_scale_table = 1 << 16;
+
 // iterations to let point converge to the attractor
 // paper suggests 20, using mantissa bits + 1
 template <typename T> struct settle_iters {};
@@ -91,7 +160,27 @@ template <> struct pix_scale<u16,double>
 
 template <typename T> inline bool bad_value(T n)
 {
-    return fabs(n) > bad_value_threshold<T>::value || isnan(n);
+    return fabs(n) > bad_value_threshold<T>::value || std::isnan(n);
+}
+
+// unsigned integer type with the same size as a floating point type
+template <typename T> struct float_bits {};
+template <> struct float_bits<float> { typedef uint32_t type; };
+template <> struct float_bits<double> { typedef uint64_t type; };
+
+// bad_value for either coordinate, without the sign bit the bit patterns
+// of nonnegative numbers (then inf, then nan) are in increasing order, so
+// this is one integer comparison with the larger magnitude
+template <typename T> inline bool bad_point(T x, T y)
+{
+    typedef typename float_bits<T>::type bits_t;
+    static const bits_t mask = ~((bits_t)1 << (8*sizeof(T)-1));
+    static const T threshold = bad_value_threshold<T>::value;
+    bits_t bx,by,bt;
+    memcpy(&bx,&x,sizeof(T));
+    memcpy(&by,&y,sizeof(T));
+    memcpy(&bt,&threshold,sizeof(T));
+    return std::max(bx & mask,by & mask) > bt;
 }
 
 template <typename T> struct rgb_t
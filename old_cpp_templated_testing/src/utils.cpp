@@ -1,12 +1,14 @@
 #include "utils.hpp"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
-#include <boost/gil.hpp>
-#include <boost/gil/extension/io/png.hpp>
+#include <png.h>
+#include <sys/stat.h>
 
 // returns the nanosecond (or most precise) performance counter
 size_t clock_nanotime()
@@ -45,52 +47,211 @@ bool string_ends_with(const std::string& string, const std::string& suffix)
     return l1 >= l2 && string.substr(l1-l2) == suffix;
 }
 
-// write 8 bit pgm image
-bool write_pgm(std::ostream& os, size_t X, size_t Y, uint8_t *img)
+PgmWriter::PgmWriter(std::ostream& os, size_t X, size_t Y, size_t bits,
+        size_t channels):
+    os(os),X(X),Y(Y),bits(bits),channels(channels),rows(0),
+    buf(std::max(chunk_size,X*channels*(bits/8))),buf_len(0)
 {
-    os << "P5" << std::endl;
+    os << (channels == 3 ? "P6" : "P5") << std::endl;
     os << X << " " << Y << std::endl;
-    os << "255" << std::endl;
-    os.write((char*)img,X*Y*sizeof(uint8_t));
+    os << (bits == 8 ? "255" : "65535") << std::endl;
+}
+
+bool PgmWriter::flush()
+{
+    os.write(buf.data(),buf_len);
+    buf_len = 0;
     return os.good();
 }
 
+bool PgmWriter::writeRow(const uint8_t *row)
+{
+    if (bits != 8 || rows >= Y)
+        return false;
+    size_t len = X*channels;
+    if (buf_len + len > buf.size() && !flush())
+        return false;
+    memcpy(buf.data()+buf_len,row,len);
+    buf_len += len;
+    ++rows;
+    return true;
+}
+
+bool PgmWriter::writeRow(const uint16_t *row)
+{
+    if (bits != 16 || rows >= Y)
+        return false;
+    size_t len = X*channels*sizeof(uint16_t);
+    if (buf_len + len > buf.size() && !flush())
+        return false;
+    // simple loop so the compiler can vectorize the byte swap
+    uint8_t *out = (uint8_t*)(buf.data()+buf_len);
+    for (size_t i = 0; i < X*channels; ++i)
+    {
+        out[2*i] = row[i] >> 8;
+        out[2*i+1] = row[i] & 0xFF;
+    }
+    buf_len += len;
+    ++rows;
+    return true;
+}
+
+bool PgmWriter::finish()
+{
+    return rows == Y && flush();
+}
+
+// write 8 bit pgm image
+bool write_pgm(std::ostream& os, size_t X, size_t Y, uint8_t *img)
+{
+    PgmWriter writer(os,X,Y,8);
+    for (size_t y = 0; y < Y; ++y, img += X)
+        if (!writer.writeRow(img))
+            return false;
+    return writer.finish();
+}
+
 // write 16 bit pgm image
 bool write_pgm(std::ostream& os, size_t X, size_t Y, uint16_t *img)
 {
-    os << "P5" << std::endl;
-    os << X << " " << Y << std::endl;
-    os << "65535" << std::endl;
-    os.write((char*)img,X*Y*sizeof(uint16_t));
+    PgmWriter writer(os,X,Y,16);
+    for (size_t y = 0; y < Y; ++y, img += X)
+        if (!writer.writeRow(img))
+            return false;
+    return writer.finish();
+}
+
+// png filter flags from name (none,sub,up,avg,paeth,all), -1 if invalid
+int png_filter_flags(const std::string& name)
+{
+    if (name == "none") return PNG_FILTER_NONE;
+    if (name == "sub") return PNG_FILTER_SUB;
+    if (name == "up") return PNG_FILTER_UP;
+    if (name == "avg") return PNG_FILTER_AVG;
+    if (name == "paeth") return PNG_FILTER_PAETH;
+    if (name == "all") return PNG_ALL_FILTERS;
+    return -1;
+}
+
+// libpng output callbacks for std::ostream
+static void png_ostream_write(png_structp png, png_bytep data, png_size_t len)
+{
+    std::ostream *os = (std::ostream*)png_get_io_ptr(png);
+    if (!os->write((char*)data,len))
+        png_error(png,"cannot write to output stream");
+}
+
+static void png_ostream_flush(png_structp png)
+{
+    ((std::ostream*)png_get_io_ptr(png))->flush();
+}
+
+PngWriter::PngWriter(std::ostream& os, size_t X, size_t Y, size_t bits,
+        int level, int filter, size_t channels):
+    os(os),png(nullptr),info(nullptr),X(X),Y(Y),bits(bits),channels(channels),
+    rows(0),good(false)
+{
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+        nullptr,nullptr,nullptr);
+    if (!png)
+        return;
+    info = png_create_info_struct(png);
+    if (!info)
+        return;
+    if (setjmp(png_jmpbuf(png)))
+        return;
+    png_set_write_fn(png,&os,png_ostream_write,png_ostream_flush);
+    if (level >= 0)
+        png_set_compression_level(png,level);
+    if (filter >= 0)
+        png_set_filter(png,PNG_FILTER_TYPE_BASE,filter);
+    png_set_IHDR(png,info,X,Y,bits,
+        channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
+        PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,
+        PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png,info);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (bits == 16) // png samples are big endian
+        png_set_swap(png);
+#endif
+    good = true;
+}
+
+PngWriter::~PngWriter()
+{
+    png_destroy_write_struct(&png,&info);
+}
+
+bool PngWriter::writeRow(const uint8_t *row)
+{
+    if (!good || bits != 8 || rows >= Y)
+        return false;
+    if (setjmp(png_jmpbuf(png)))
+        return good = false;
+    png_write_row(png,(png_const_bytep)row);
+    ++rows;
+    return true;
+}
+
+bool PngWriter::writeRow(const uint16_t *row)
+{
+    if (!good || bits != 16 || rows >= Y)
+        return false;
+    if (setjmp(png_jmpbuf(png)))
+        return good = false;
+    png_write_row(png,(png_const_bytep)row);
+    ++rows;
+    return true;
+}
+
+bool PngWriter::finish()
+{
+    if (!good || rows != Y)
+        return false;
+    if (setjmp(png_jmpbuf(png)))
+        return good = false;
+    png_write_end(png,nullptr);
     return os.good();
 }
 
 // write 8 bit grayscale png image
-bool write_png(std::ostream& os, size_t X, size_t Y, uint8_t *img)
+bool write_png(std::ostream& os, size_t X, size_t Y, uint8_t *img,
+        int level, int filter)
 {
-    boost::gil::gray8_image_t image(X,Y);
-    auto image_view = boost::gil::view(image);
-    for (size_t y = 0; y < Y; ++y)
-    {
-        auto ptr = image_view.row_begin(y);
-        for (size_t x = 0; x < X; ++x)
-            ptr[x] = *(img++);
-    }
-    boost::gil::write_view(os,image_view,boost::gil::png_tag());
-    return os.good();
+    PngWriter writer(os,X,Y,8,level,filter);
+    for (size_t y = 0; y < Y; ++y, img += X)
+        if (!writer.writeRow(img))
+            return false;
+    return writer.finish();
 }
 
 // write 16 bit grayscale png image
-bool write_png(std::ostream& os, size_t X, size_t Y, uint16_t *img)
+bool write_png(std::ostream& os, size_t X, size_t Y, uint16_t *img,
+        int level, int filter)
 {
-    boost::gil::gray16_image_t image(X,Y);
-    auto image_view = boost::gil::view(image);
-    for (size_t y = 0; y < Y; ++y)
-    {
-        auto ptr = image_view.row_begin(y);
-        for (size_t x = 0; x < X; ++x)
-            ptr[x] = *(img++);
-    }
-    boost::gil::write_view(os,image_view,boost::gil::png_tag());
-    return os.good();
+    PngWriter writer(os,X,Y,16,level,filter);
+    for (size_t y = 0; y < Y; ++y, img += X)
+        if (!writer.writeRow(img))
+            return false;
+    return writer.finish();
+}
+
+// write 8 bit grayscale image file (png or pgm by extension), regular files
+// are written to a temporary name and renamed so readers never see a partial
+// image, anything else (such as a fifo) is written directly
+bool write_image_file(const std::string& name, size_t X, size_t Y,
+        uint8_t *img)
+{
+    struct stat st;
+    bool direct = stat(name.c_str(),&st) == 0 && !S_ISREG(st.st_mode);
+    std::string tmp_name = direct ? name : name + ".tmp";
+    std::ofstream ofs(tmp_name,std::ios::out|std::ios::binary);
+    if (!ofs)
+        return false;
+    bool ok = string_ends_with(name,".png")
+        ? write_png(ofs,X,Y,img,1) : write_pgm(ofs,X,Y,img);
+    ofs.close();
+    if (!ok || !ofs)
+        return false;
+    return direct || rename(tmp_name.c_str(),name.c_str()) == 0;
 }
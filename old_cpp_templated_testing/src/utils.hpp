@@ -1,6 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <iosfwd>
 #include <string>
+#include <vector>
+
+// libpng types, defined in png.h
+struct png_struct_def;
+struct png_info_def;
 
 // returns the nanosecond (or most precise) performance counter
 size_t clock_nanotime();
@@ -14,14 +21,81 @@ void error_and_exit(const char *f, ...);
 // true if string ends with the provided suffix
 bool string_ends_with(const std::string& string, const std::string& suffix);
 
+/*
+pgm (1 channel) or ppm (3 channels, rgb) writer, rows are written top to
+bottom and buffered into large chunks
+16 bit samples are converted to big endian as required by the format
+*/
+class PgmWriter
+{
+private:
+    std::ostream& os;
+    size_t X,Y,bits,channels;
+    size_t rows; // rows written so far
+    std::vector<char> buf; // pending output
+    size_t buf_len; // bytes used in buf
+    bool flush();
+    PgmWriter(const PgmWriter&) = delete;
+    PgmWriter& operator=(const PgmWriter&) = delete;
+public:
+    // chunk size for writes to the output stream
+    static const size_t chunk_size = 1 << 20;
+    PgmWriter(std::ostream& os, size_t X, size_t Y, size_t bits,
+        size_t channels = 1);
+    // write next row (X pixels, channels interleaved), type must match bits
+    bool writeRow(const uint8_t *row);
+    bool writeRow(const uint16_t *row);
+    // write remaining buffered data, must be called after all rows
+    bool finish();
+};
+
 // write 8 bit pgm image
 bool write_pgm(std::ostream& os, size_t X, size_t Y, uint8_t *img);
 
 // write 16 bit pgm image
 bool write_pgm(std::ostream& os, size_t X, size_t Y, uint16_t *img);
 
+// png filter flags from name (none,sub,up,avg,paeth,all), -1 if invalid
+int png_filter_flags(const std::string& name);
+
+/*
+png writer using libpng, rows are written top to bottom as they are produced
+so the whole image does not need to be in memory
+level - zlib compression level (0-9, -1 for default)
+filter - png filter flags (see png_filter_flags, -1 for default)
+channels - 1 for grayscale, 3 for rgb
+*/
+class PngWriter
+{
+private:
+    std::ostream& os;
+    png_struct_def *png;
+    png_info_def *info;
+    size_t X,Y,bits,channels;
+    size_t rows; // rows written so far
+    bool good; // no libpng errors so far
+    PngWriter(const PngWriter&) = delete;
+    PngWriter& operator=(const PngWriter&) = delete;
+public:
+    PngWriter(std::ostream& os, size_t X, size_t Y, size_t bits,
+        int level = -1, int filter = -1, size_t channels = 1);
+    ~PngWriter();
+    // write next row (X pixels, channels interleaved), type must match bits
+    bool writeRow(const uint8_t *row);
+    bool writeRow(const uint16_t *row);
+    // write end of image, must be called after all rows are written
+    bool finish();
+};
+
 // write 8 bit grayscale png image
-bool write_png(std::ostream& os, size_t X, size_t Y, uint8_t *img);
+bool write_png(std::ostream& os, size_t X, size_t Y, uint8_t *img,
+    int level = -1, int filter = -1);
 
 // write 16 bit grayscale png image
-bool write_png(std::ostream& os, size_t X, size_t Y, uint16_t *img);
+bool write_png(std::ostream& os, size_t X, size_t Y, uint16_t *img,
+    int level = -1, int filter = -1);
+
+// write 8 bit grayscale png (.png extension) or pgm file, replaced atomically
+// if it is a regular file, written directly otherwise (such as a fifo)
+bool write_image_file(const std::string& name, size_t X, size_t Y,
+    uint8_t *img);